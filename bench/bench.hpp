@@ -0,0 +1,445 @@
+#pragma once
+
+#include "json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// Microbenchmark harness for GreyHeavens_bench
+///
+/// Repetition scheme, per case:
+/// - Calibrate: the iteration count doubles until one sample takes at least
+///   Options::min_sample_ms, so timer resolution never dominates.
+/// - Warm up: Options::warmup samples are run and thrown away (caches, driver
+///   shader caches, lazy allocations).
+/// - Measure: Options::samples samples at that fixed iteration count, each one
+///   becomes one ns/op value. Nothing gets discarded, outliers are only counted
+///   (further than 3 scaled MADs from the median).
+///
+/// Reported: median with a distribution free 95% confidence interval (order
+/// statistics), mean, stddev, MAD and min. Comparison between two result
+/// files uses a Mann-Whitney U test on the raw samples, so a change is only
+/// flagged when it is both significant and bigger than the threshold.
+namespace Bench {
+
+struct Options {
+    int samples = 30;
+    int warmup = 3;
+    double min_sample_ms = 5.0;
+    std::string filter;
+    bool gl = true;
+};
+
+// Timed body, runs `iterations` times per call
+typedef std::function<void(uint64_t iterations)> Body;
+// Runs once per case outside the timing, the body it returns is what gets measured.
+// Anything the body needs lives in its captures and dies with it.
+typedef std::function<Body()> Setup;
+
+struct Case {
+    std::string name;
+    bool needs_gl;
+    Setup setup;
+};
+
+struct Summary {
+    double min = 0.0;
+    double median = 0.0;
+    double mean = 0.0;
+    double stddev = 0.0;
+    double mad = 0.0; // scaled to match stddev for normal data
+    double ci_low = 0.0;
+    double ci_high = 0.0;
+    int outliers = 0;
+};
+
+struct Result {
+    std::string name;
+    uint64_t iterations = 0; // per sample
+    std::vector<double> samples; // ns/op
+    Summary summary;
+    std::map<std::string, double> counters;
+    std::string failure; // empty when the case passed its own checks
+};
+
+inline std::vector<Case>& Registry()
+{
+    static std::vector<Case> cases;
+    return cases;
+}
+
+inline void Register(const std::string &name, bool needs_gl, Setup setup)
+{
+    Registry().push_back({ name, needs_gl, setup });
+}
+
+///
+/// Reporting from inside a case (setup or body)
+///
+inline Result*& currentResult()
+{
+    static Result* result = nullptr;
+    return result;
+}
+
+// Extra numbers that belong to the result, e.g. triangles drawn
+inline void SetCounter(const std::string &name, double value)
+{
+    if (currentResult())
+        currentResult()->counters[name] = value;
+}
+
+// Marks the case failed, GreyHeavens_bench exits non-zero
+inline void Fail(const std::string &reason)
+{
+    if (currentResult() && currentResult()->failure.empty())
+        currentResult()->failure = reason;
+}
+
+///
+/// Keeping the optimizer honest
+///
+template <typename T>
+inline void DoNotOptimize(T const &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+inline void ClobberMemory()
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+///
+/// Statistics
+///
+inline double percentileSorted(const std::vector<double> &sorted, double rank)
+{
+    if (sorted.empty())
+        return 0.0;
+    rank = std::clamp(rank, 0.0, (double)sorted.size() - 1.0);
+    size_t low = (size_t)std::floor(rank);
+    size_t high = (size_t)std::ceil(rank);
+    return sorted[low] + (sorted[high] - sorted[low]) * (rank - (double)low);
+}
+
+inline Summary Summarize(const std::vector<double> &samples)
+{
+    Summary summary;
+    if (samples.empty())
+        return summary;
+
+    std::vector<double> sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    double n = (double)sorted.size();
+
+    summary.min = sorted.front();
+    summary.median = percentileSorted(sorted, (n - 1.0) * 0.5);
+
+    double sum = 0.0;
+    for (double sample : sorted)
+        sum += sample;
+    summary.mean = sum / n;
+
+    double squares = 0.0;
+    for (double sample : sorted)
+        squares += (sample - summary.mean) * (sample - summary.mean);
+    summary.stddev = sorted.size() > 1 ? std::sqrt(squares / (n - 1.0)) : 0.0;
+
+    std::vector<double> deviations;
+    for (double sample : sorted)
+        deviations.push_back(std::abs(sample - summary.median));
+    std::sort(deviations.begin(), deviations.end());
+    summary.mad = 1.4826 * percentileSorted(deviations, (n - 1.0) * 0.5);
+
+    // Order statistic interval of the median, normal approximation of the binomial.
+    // 1 based ranks floor(n/2 - h) and ceil(1 + n/2 + h), h = 1.96 * sqrt(n) / 2
+    double half_width = 1.96 * std::sqrt(n) * 0.5;
+    summary.ci_low = percentileSorted(sorted, std::floor(n * 0.5 - half_width) - 1.0);
+    summary.ci_high = percentileSorted(sorted, std::ceil(1.0 + n * 0.5 + half_width) - 1.0);
+
+    for (double sample : sorted) {
+        if (summary.mad > 0.0 && std::abs(sample - summary.median) > 3.0 * summary.mad)
+            ++summary.outliers;
+    }
+    return summary;
+}
+
+// Two sided p-value of the Mann-Whitney U test, normal approximation with tie correction
+inline double MannWhitneyP(const std::vector<double> &a, const std::vector<double> &b)
+{
+    if (a.empty() || b.empty())
+        return 1.0;
+
+    std::vector<std::pair<double, int>> all;
+    for (double value : a) all.push_back({ value, 0 });
+    for (double value : b) all.push_back({ value, 1 });
+    std::sort(all.begin(), all.end());
+
+    double n1 = (double)a.size(), n2 = (double)b.size(), n = n1 + n2;
+    double rank_sum_a = 0.0;
+    double tie_term = 0.0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first)
+            ++j;
+        double average_rank = (double)(i + j + 1) * 0.5; // ranks are 1 based
+        double ties = (double)(j - i);
+        tie_term += ties * ties * ties - ties;
+        for (size_t k = i; k < j; ++k) {
+            if (all[k].second == 0)
+                rank_sum_a += average_rank;
+        }
+        i = j;
+    }
+
+    double u = rank_sum_a - n1 * (n1 + 1.0) * 0.5;
+    double mean = n1 * n2 * 0.5;
+    double variance = n1 * n2 / 12.0 * ((n + 1.0) - tie_term / (n * (n - 1.0)));
+    if (variance <= 0.0)
+        return 1.0;
+
+    double z = (std::abs(u - mean) - 0.5) / std::sqrt(variance);
+    if (z < 0.0)
+        z = 0.0;
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+///
+/// Running
+///
+inline double runSample(const Body &body, uint64_t iterations)
+{
+    auto start = std::chrono::steady_clock::now();
+    body(iterations);
+    ClobberMemory();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+inline Result Run(const Case &bench_case, const Options &options)
+{
+    Result result;
+    result.name = bench_case.name;
+    currentResult() = &result;
+
+    Body body = bench_case.setup();
+    if (body) {
+        double min_sample_ns = options.min_sample_ms * 1e6;
+        uint64_t iterations = 1;
+        while (iterations < (1ull << 30) && runSample(body, iterations) < min_sample_ns)
+            iterations *= 2;
+        result.iterations = iterations;
+
+        for (int i = 0; i < options.warmup; ++i)
+            runSample(body, iterations);
+        for (int i = 0; i < options.samples; ++i)
+            result.samples.push_back(runSample(body, iterations) / (double)iterations);
+        result.summary = Summarize(result.samples);
+    }
+    else {
+        Fail("setup failed");
+    }
+
+    body = nullptr; // tear down while the result can still take counters
+    currentResult() = nullptr;
+    return result;
+}
+
+///
+/// Output
+///
+inline std::string FormatTime(double ns)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    if (ns >= 1e6)
+        out << ns / 1e6 << " ms";
+    else if (ns >= 1e3)
+        out << ns / 1e3 << " us";
+    else
+        out << ns << " ns";
+    return out.str();
+}
+
+inline void PrintResult(const Result &result)
+{
+    const Summary &s = result.summary;
+    std::cout << std::left << std::setw(40) << result.name << std::right
+              << std::setw(12) << FormatTime(s.median)
+              << "  [" << FormatTime(s.ci_low) << ", " << FormatTime(s.ci_high) << "]"
+              << "  mad " << FormatTime(s.mad)
+              << "  x" << result.iterations;
+    if (s.outliers)
+        std::cout << "  (" << s.outliers << " outliers)";
+    for (const auto &counter : result.counters)
+        std::cout << "  " << counter.first << "=" << counter.second;
+    if (!result.failure.empty())
+        std::cout << "  FAILED: " << result.failure;
+    std::cout << std::endl;
+}
+
+inline void WriteJson(std::ostream &out, const std::vector<Result> &results, const Options &options)
+{
+    out << std::setprecision(10);
+    out << "{\n"
+        << "  \"format\": \"greyheavens-bench-1\",\n"
+#ifdef NDEBUG
+        << "  \"build\": \"release\",\n"
+#else
+        << "  \"build\": \"debug\",\n"
+#endif
+        << "  \"options\": { \"samples\": " << options.samples << ", \"warmup\": " << options.warmup
+        << ", \"min_sample_ms\": " << options.min_sample_ms << " },\n"
+        << "  \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        const Summary &s = r.summary;
+        out << (i ? ",\n" : "\n")
+            << "    {\n"
+            << "      \"name\": \"" << Json::Escape(r.name) << "\",\n"
+            << "      \"unit\": \"ns/op\",\n"
+            << "      \"iterations_per_sample\": " << r.iterations << ",\n"
+            << "      \"median\": " << s.median << ", \"ci95_low\": " << s.ci_low << ", \"ci95_high\": " << s.ci_high << ",\n"
+            << "      \"mean\": " << s.mean << ", \"stddev\": " << s.stddev << ", \"mad\": " << s.mad
+            << ", \"min\": " << s.min << ", \"outliers\": " << s.outliers << ",\n"
+            << "      \"counters\": {";
+        size_t c = 0;
+        for (const auto &counter : r.counters)
+            out << (c++ ? ", " : " ") << "\"" << Json::Escape(counter.first) << "\": " << counter.second;
+        out << (r.counters.empty() ? "" : " ") << "},\n";
+        if (!r.failure.empty())
+            out << "      \"failure\": \"" << Json::Escape(r.failure) << "\",\n";
+        out << "      \"samples\": [";
+        for (size_t j = 0; j < r.samples.size(); ++j)
+            out << (j ? ", " : "") << r.samples[j];
+        out << "]\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+inline bool ReadJson(const std::string &path, std::vector<Result> &results)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    Json::Value root;
+    if (!Json::Parser(text).Parse(root))
+        return false;
+    const Json::Value* list = root.Find("results");
+    if (!list || list->type != Json::JSON_ARRAY)
+        return false;
+
+    for (const Json::Value &entry : list->array) {
+        Result result;
+        result.name = entry.StringOr("name", "");
+        result.iterations = (uint64_t)entry.NumberOr("iterations_per_sample", 0.0);
+        result.failure = entry.StringOr("failure", "");
+        if (const Json::Value* samples = entry.Find("samples")) {
+            for (const Json::Value &sample : samples->array)
+                result.samples.push_back(sample.number);
+        }
+        if (const Json::Value* counters = entry.Find("counters")) {
+            for (const auto &counter : counters->object)
+                result.counters[counter.first] = counter.second.number;
+        }
+        result.summary = Summarize(result.samples);
+        results.push_back(result);
+    }
+    return true;
+}
+
+///
+/// Comparison
+///
+struct CompareOptions {
+    double threshold = 0.05; // relative change of the median that matters
+    double alpha = 0.01;     // significance level
+};
+
+// Prints a table, returns the number of regressions
+inline int Compare(const std::vector<Result> &base, const std::vector<Result> &current, const CompareOptions &options)
+{
+    int regressions = 0;
+    std::cout << std::left << std::setw(40) << "case" << std::right
+              << std::setw(12) << "base" << std::setw(12) << "new"
+              << std::setw(10) << "change" << std::setw(10) << "p" << "  verdict" << std::endl;
+
+    for (const Result &now : current) {
+        auto it = std::find_if(base.begin(), base.end(), [&](const Result &r) { return r.name == now.name; });
+        if (it == base.end()) {
+            std::cout << std::left << std::setw(40) << now.name << std::right << std::setw(12) << "-"
+                      << std::setw(12) << FormatTime(now.summary.median) << "  new case" << std::endl;
+            continue;
+        }
+
+        double change = it->summary.median > 0.0 ? now.summary.median / it->summary.median - 1.0 : 0.0;
+        double p = MannWhitneyP(it->samples, now.samples);
+        bool significant = p < options.alpha;
+
+        const char* verdict = "same";
+        if (significant && change > options.threshold) {
+            verdict = "REGRESSION";
+            ++regressions;
+        }
+        else if (significant && change < -options.threshold) {
+            verdict = "improved";
+        }
+        if (!now.failure.empty()) {
+            verdict = "FAILED";
+            ++regressions;
+        }
+
+        std::ostringstream change_text, p_text;
+        change_text << std::showpos << std::fixed << std::setprecision(1) << change * 100.0 << "%";
+        p_text << std::setprecision(2) << p;
+        std::cout << std::left << std::setw(40) << now.name << std::right
+                  << std::setw(12) << FormatTime(it->summary.median)
+                  << std::setw(12) << FormatTime(now.summary.median)
+                  << std::setw(10) << change_text.str()
+                  << std::setw(10) << p_text.str()
+                  << "  " << verdict << std::endl;
+    }
+
+    for (const Result &old : base) {
+        bool present = std::any_of(current.begin(), current.end(), [&](const Result &r) { return r.name == old.name; });
+        if (!present)
+            std::cout << std::left << std::setw(40) << old.name << std::right << "  missing from new results" << std::endl;
+    }
+    return regressions;
+}
+
+}
+
+///
+/// Case registration, one function per source file, called from bench_main.cpp
+///
+void RegisterEngineCases();
+void RegisterLightingCases();
+void RegisterWorldCases();
+void RegisterParticleCases();
+void RegisterDebugDrawCases();
+void RegisterLodCases();
+void RegisterResourceCases();
@@ -0,0 +1,72 @@
+/// Debug drawing: filling the ring buffer with thousands of shapes a frame
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <Utils/debug_draw.hpp>
+
+#include "bench.hpp"
+
+#include <memory>
+#include <string>
+
+const int DEBUG_BOXES = 10000;
+
+// A frame worth of culling output: boxes on a grid, a sphere every 16th, a few frustums
+static void DrawFrame(DebugDraw &debug)
+{
+    for (int i = 0; i < DEBUG_BOXES; ++i) {
+        glm::vec3 min((float)(i % 100), 0.0f, (float)(i / 100));
+        debug.Box(min, min + glm::vec3(0.8f), DEBUG_GREEN);
+        if (i % 16 == 0)
+            debug.Sphere(min + glm::vec3(0.4f), 0.5f, DEBUG_YELLOW);
+    }
+    glm::mat4 projection = glm::perspective(45.0f, 16.0f / 9.0f, 0.1f, 50.0f);
+    for (int i = 0; i < 4; ++i) {
+        glm::mat4 view = glm::lookAt(glm::vec3(10.0f * i, 2.0f, 0.0f), glm::vec3(10.0f * i, 0.0f, 10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        debug.Frustum(projection * view, DEBUG_MAGENTA, DEBUG_OVERLAY);
+    }
+    debug.Axes(glm::mat4(1.0f));
+}
+
+static void RegisterFrameCase(bool gl)
+{
+    std::string name = gl ? "debug_draw/draw_10k_boxes" : "debug_draw/append_10k_boxes";
+
+    Bench::Register(name, gl, [gl] {
+        std::shared_ptr<DebugDraw> debug(new DebugDraw(), [](DebugDraw* debug) {
+            debug->Release();
+            delete debug;
+        });
+        debug->Init(DEBUG_DRAW_FRAME_BYTES, gl);
+        glm::mat4 view = glm::lookAt(glm::vec3(50.0f, 40.0f, -30.0f), glm::vec3(50.0f, 0.0f, 50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(45.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+
+        // Once outside the timing, everything has to fit in one region
+        DrawFrame(*debug);
+        debug->Draw(view, projection);
+        if (debug->Stats.dropped > 0)
+            Bench::Fail("frame did not fit in the ring buffer region");
+        if (gl && debug->Stats.draws != 2)
+            Bench::Fail("expected one depth tested and one overlay line draw");
+
+        return Bench::Body([debug, view, projection, gl](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                DrawFrame(*debug);
+                debug->Draw(view, projection);
+            }
+            if (gl)
+                glFinish();
+            Bench::SetCounter("vertices", debug->Stats.vertices);
+            Bench::SetCounter("draws", debug->Stats.draws);
+            Bench::SetCounter("fence_wait_ms", debug->Stats.wait_ms);
+        });
+    });
+}
+
+void RegisterDebugDrawCases()
+{
+    RegisterFrameCase(false);
+    RegisterFrameCase(true);
+}
@@ -0,0 +1,177 @@
+/// Engine hot paths: per-box matrices, camera, image decode and Shader
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <Utils/camera.hpp>
+#include <Utils/image.hpp>
+#include <Utils/shader.hpp>
+
+#include "bench.hpp"
+
+#include <memory>
+#include <vector>
+
+// Same layout as boxes_pos in main.cpp: three stacks, the last two leaning
+static std::vector<glm::vec3> BoxPositions()
+{
+    std::vector<glm::vec3> positions;
+    for (int i = 0; i <= 10; ++i)
+        positions.push_back(glm::vec3(0.0f, (float)i, 0.0f));
+    for (int stack = 1; stack <= 2; ++stack) {
+        for (int i = 0; i < 10; ++i)
+            positions.push_back(glm::vec3((float)stack + 0.1f * i, (float)i, 0.0f));
+    }
+    return positions;
+}
+
+static void RegisterMatrixCases()
+{
+    // What SDL_AppIterate does for every box, per frame
+    Bench::Register("matrix/boxes_frame", false, [] {
+        auto positions = std::make_shared<std::vector<glm::vec3>>(BoxPositions());
+        auto models = std::make_shared<std::vector<glm::mat4>>();
+        models->reserve(positions->size());
+
+        return Bench::Body([positions, models](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                models->clear();
+                for (const glm::vec3 &position : *positions) {
+                    glm::mat4 model = glm::mat4(1);
+                    model = glm::translate(model, position);
+                    models->push_back(model);
+                }
+                Bench::DoNotOptimize(models->data());
+            }
+        });
+    });
+
+    Bench::Register("matrix/perspective", false, [] {
+        return Bench::Body([](uint64_t iterations) {
+            float aspect = 16.0f / 9.0f;
+            for (uint64_t it = 0; it < iterations; ++it) {
+                glm::mat4 projection = glm::perspective(45.0f, aspect, 0.01f, 1000.0f);
+                Bench::DoNotOptimize(projection);
+                aspect += 1e-6f;
+            }
+        });
+    });
+}
+
+static void RegisterCameraCases()
+{
+    Bench::Register("camera/process_mouse_movement", false, [] {
+        auto camera = std::make_shared<Camera>(glm::vec3(0.0f, 2.0f, 7.0f));
+        return Bench::Body([camera](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                // Wiggle around so pitch clamping and the trig see real values
+                float offset = (it & 1) ? 3.0f : -3.0f;
+                camera->ProcessMouseMovement(offset, -offset * 0.5f);
+            }
+            Bench::DoNotOptimize(camera->Front);
+        });
+    });
+
+    Bench::Register("camera/get_view_matrix", false, [] {
+        auto camera = std::make_shared<Camera>(glm::vec3(0.0f, 2.0f, 7.0f));
+        return Bench::Body([camera](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                glm::mat4 view = camera->GetViewMatrix();
+                Bench::DoNotOptimize(view);
+                camera->Position.x += 1e-4f;
+            }
+        });
+    });
+}
+
+static void RegisterImageCases()
+{
+    // Same decode MaterialFromFile runs, VFS read included
+    const char* images[][2] = {
+        { "image/decode_png", "textures/reimu_timbersaw.png" },
+        { "image/decode_jpg", "textures/bad_morning.jpg" },
+    };
+
+    for (auto &image : images) {
+        std::string path = image[1];
+        Bench::Register(image[0], false, [path] {
+            int width, height, nrComponents;
+            if (!ImageInfo(path, &width, &height, &nrComponents))
+                return Bench::Body();
+            Bench::SetCounter("pixels", (double)width * height);
+
+            return Bench::Body([path](uint64_t iterations) {
+                stbi_set_flip_vertically_on_load(true);
+                for (uint64_t it = 0; it < iterations; ++it) {
+                    int width, height, nrComponents;
+                    unsigned char *data = LoadImageFile(path, &width, &height, &nrComponents, 0);
+                    Bench::DoNotOptimize(data);
+                    stbi_image_free(data);
+                }
+            });
+        });
+    }
+}
+
+static void RegisterShaderCases()
+{
+    // Link status is queried right away, so the driver can't defer the work past the timer
+    Bench::Register("shader/compile_link_cube", true, [] {
+        return Bench::Body([](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                Shader shader("shaders/basic/cube.vert", "shaders/basic/cube.frag");
+                glDeleteProgram(shader.ID);
+            }
+        });
+    });
+
+    // Uniform setters look the location up by name every call, that's what we pay for
+    auto shader_setup = [] {
+        std::shared_ptr<Shader> shader(new Shader("shaders/basic/cube.vert", "shaders/basic/cube.frag"), [](Shader* shader) {
+            glDeleteProgram(shader->ID);
+            delete shader;
+        });
+        shader->use();
+        return shader;
+    };
+
+    Bench::Register("shader/set_mat4", true, [shader_setup] {
+        auto shader = shader_setup();
+        return Bench::Body([shader](uint64_t iterations) {
+            glm::mat4 view = glm::mat4(1);
+            for (uint64_t it = 0; it < iterations; ++it) {
+                view[3][0] = (float)(it & 0xFF);
+                shader->setMat4("view", view);
+            }
+            glFinish();
+        });
+    });
+
+    Bench::Register("shader/set_int", true, [shader_setup] {
+        auto shader = shader_setup();
+        return Bench::Body([shader](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it)
+                shader->setInt("texture_page", (int)(it & 7));
+            glFinish();
+        });
+    });
+
+    Bench::Register("shader/get_uniform_location", true, [shader_setup] {
+        auto shader = shader_setup();
+        return Bench::Body([shader](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                GLint location = glGetUniformLocation(shader->ID, "projection");
+                Bench::DoNotOptimize(location);
+            }
+        });
+    });
+}
+
+void RegisterEngineCases()
+{
+    RegisterMatrixCases();
+    RegisterCameraCases();
+    RegisterImageCases();
+    RegisterShaderCases();
+}
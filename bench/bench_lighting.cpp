@@ -0,0 +1,82 @@
+/// Clustered lighting: CPU light assignment against light count
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <Utils/camera.hpp>
+#include <Utils/clustered_lighting.hpp>
+
+#include "bench.hpp"
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Same density as the demo scene, spread over a bigger area so the count can grow
+static std::vector<Light> RandomLights(unsigned int count)
+{
+    std::mt19937 random(1337);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Keeps the average lights per froxel about the same as count grows
+    float extent = 8.0f * std::sqrt((float)count / 256.0f);
+
+    std::vector<Light> lights(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        Light &light = lights[i];
+        light.position = glm::vec3(extent * (2.0f * unit(random) - 1.0f), -1.0f + 12.0f * unit(random), 7.0f - 2.0f * extent * unit(random));
+        light.color = glm::vec3(unit(random), unit(random), unit(random));
+        light.radius = 1.5f + 1.5f * unit(random);
+        if (i % 8 == 7) {
+            light.type = LIGHT_SPOT;
+            light.radius *= 3.0f;
+        }
+    }
+    return lights;
+}
+
+static void RegisterAssignCase(unsigned int light_count, unsigned int max_threads)
+{
+    std::string name = "lighting/assign_" + std::to_string(light_count);
+    if (max_threads == 1)
+        name += "_single_thread";
+
+    Bench::Register(name, false, [light_count, max_threads] {
+        auto lighting = std::make_shared<ClusteredLighting>();
+        auto lights = std::make_shared<std::vector<Light>>(RandomLights(light_count));
+        lighting->MaxThreads = max_threads;
+
+        Camera camera(glm::vec3(0.0f, 2.0f, 7.0f));
+        glm::mat4 view = camera.GetViewMatrix();
+        glm::mat4 projection = glm::perspective(45.0f, 16.0f / 9.0f, 0.01f, 1000.0f);
+
+        // Once outside the timing, for the counters and the sanity check
+        lighting->Assign(view, projection, 0.01f, 1000.0f, *lights);
+        const ClusterStats &stats = lighting->Stats;
+        Bench::SetCounter("lights", stats.lights);
+        Bench::SetCounter("visible_lights", stats.visible_lights);
+        Bench::SetCounter("light_indices", stats.light_indices);
+        Bench::SetCounter("max_cluster_lights", stats.max_cluster_lights);
+        Bench::SetCounter("overflowed_clusters", stats.overflowed_clusters);
+        if (stats.visible_lights == 0)
+            Bench::Fail("no light reached a cluster");
+
+        return Bench::Body([lighting, lights, view, projection](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                lighting->Assign(view, projection, 0.01f, 1000.0f, *lights);
+                Bench::DoNotOptimize(lighting->Stats.light_indices);
+            }
+        });
+    });
+}
+
+void RegisterLightingCases()
+{
+    for (unsigned int count : { 256u, 1024u, 4096u, 16384u })
+        RegisterAssignCase(count, 0);
+
+    // What the job system buys us
+    RegisterAssignCase(4096, 1);
+}
@@ -0,0 +1,308 @@
+/// Mesh LOD: simplifying a chunk and a seamed sphere, selecting levels over a large scene
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <Utils/mesh_lod.hpp>
+#include <Utils/world_streaming.hpp>
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+const float LOD_VIEWPORT_HEIGHT = 1080.0f;
+
+// Ground away from the flattened origin, so there is something to simplify
+static ChunkData HillyChunk(int resolution, const std::vector<float> &lod_errors)
+{
+    StreamingSettings settings;
+    settings.resolution = resolution;
+    settings.lod_errors = lod_errors;
+    ChunkData chunk;
+    GenerateChunk({ 6, -4 }, settings, chunk);
+    return chunk;
+}
+
+// Worst distance from a vertex the full mesh uses to the level's surface, brute force over every triangle.
+// What the level's stored error has to cover.
+static float MaxDeviation(const float* vertices, uint32_t stride, const uint32_t* full, size_t full_count, const uint32_t* triangles, size_t index_count)
+{
+    auto position = [&](uint32_t v) { return glm::vec3(vertices[(size_t)v * stride], vertices[(size_t)v * stride + 1], vertices[(size_t)v * stride + 2]); };
+    std::vector<uint32_t> used(full, full + full_count);
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+
+    float worst = 0.0f;
+    for (uint32_t v : used) {
+        glm::vec3 p = position(v);
+        float nearest = INFINITY;
+        for (size_t i = 0; i < index_count; i += 3)
+            nearest = std::min(nearest, LodDetail::PointTriangleDistanceSquared(p, position(triangles[i]), position(triangles[i + 1]), position(triangles[i + 2])));
+        worst = std::max(worst, nearest);
+    }
+    return std::sqrt(worst);
+}
+
+static float LevelDeviation(const ChunkData &chunk, const LodLevel &level)
+{
+    return MaxDeviation(chunk.vertices.data(), 5, chunk.indices.data(), chunk.lods[0].index_count, chunk.indices.data() + level.index_offset, level.index_count);
+}
+
+static void RegisterSimplifyChunkCase()
+{
+    // Building the LOD chain of a 64x64 chunk, what a streaming worker pays on top of generating it
+    Bench::Register("lod/simplify_chunk_64", false, [] {
+        std::vector<float> targets = { 0.01f, 0.03f, 0.1f };
+        ChunkData chunk = HillyChunk(64, targets);
+        int side = 65;
+        size_t vertex_count = (size_t)side * side;
+
+        if (chunk.lods.size() < 2)
+            Bench::Fail("no level got simpler than full detail");
+
+        // Every level: smaller than the one before, error no less than what it really deviates, facing the same way as full detail,
+        // and every border vertex still in place so neighbouring chunks meet. Triangles made of three border
+        // vertices stand upright (no area from above), they are what keeps the edge watertight.
+        const uint32_t* full = chunk.indices.data();
+        float full_facing = (chunk.vertices[full[1] * 5 + 2] - chunk.vertices[full[0] * 5 + 2]) * (chunk.vertices[full[2] * 5] - chunk.vertices[full[0] * 5])
+                          - (chunk.vertices[full[1] * 5] - chunk.vertices[full[0] * 5]) * (chunk.vertices[full[2] * 5 + 2] - chunk.vertices[full[0] * 5 + 2]);
+        for (size_t l = 0; l < chunk.lods.size(); ++l) {
+            const LodLevel &level = chunk.lods[l];
+            const uint32_t* triangles = chunk.indices.data() + level.index_offset;
+            if (l > 0 && level.index_count >= chunk.lods[l - 1].index_count)
+                Bench::Fail("level " + std::to_string(l) + " is not smaller than the one before");
+            float deviation = LevelDeviation(chunk, level);
+            if (level.error < deviation)
+                Bench::Fail("level " + std::to_string(l) + " error under its measured deviation");
+
+            std::vector<bool> used(vertex_count, false);
+            for (uint32_t i = 0; i < level.index_count; i += 3) {
+                const float* a = &chunk.vertices[triangles[i] * 5];
+                const float* b = &chunk.vertices[triangles[i + 1] * 5];
+                const float* c = &chunk.vertices[triangles[i + 2] * 5];
+                float facing = (b[2] - a[2]) * (c[0] - a[0]) - (b[0] - a[0]) * (c[2] - a[2]);
+                if (facing * full_facing < 0.0f)
+                    Bench::Fail("level " + std::to_string(l) + " has a flipped triangle");
+                used[triangles[i]] = used[triangles[i + 1]] = used[triangles[i + 2]] = true;
+            }
+            for (int k = 0; k < side; ++k) {
+                if (!used[k] || !used[(size_t)(side - 1) * side + k] || !used[(size_t)k * side] || !used[(size_t)k * side + side - 1])
+                    Bench::Fail("level " + std::to_string(l) + " lost a border vertex");
+            }
+
+            std::string prefix = "level" + std::to_string(l) + "_";
+            Bench::SetCounter(prefix + "triangles", level.index_count / 3);
+            Bench::SetCounter(prefix + "error", level.error);
+            Bench::SetCounter(prefix + "max_deviation", deviation);
+        }
+
+        auto base = std::make_shared<std::vector<uint32_t>>(chunk.indices.begin(), chunk.indices.begin() + chunk.lods[0].index_count);
+        auto vertices = std::make_shared<std::vector<float>>(chunk.vertices);
+        return Bench::Body([base, vertices, vertex_count, targets](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                std::vector<uint32_t> indices = *base;
+                std::vector<LodLevel> levels = BuildLods(vertices->data(), vertex_count, 5, indices, targets, LOD_LOCK_BORDER);
+                Bench::DoNotOptimize(levels.data());
+            }
+        });
+    });
+}
+
+static void RegisterSimplifySphereCase()
+{
+    // UV sphere with its seam column doubled, the seam has to survive every level untouched
+    Bench::Register("lod/simplify_seamed_sphere", false, [] {
+        const int rings = 48, segments = 96;
+        auto mesh = std::make_shared<LodMesh>();
+        for (int ring = 0; ring <= rings; ++ring) {
+            float theta = 3.14159265f * ring / rings;
+            for (int segment = 0; segment <= segments; ++segment) {
+                // Last column repeats the first position with u = 1
+                float phi = 6.28318531f * (segment % segments) / segments;
+                float r = 1.0f + 0.03f * std::sin(5.0f * theta) * std::cos(3.0f * phi);
+                mesh->vertices.insert(mesh->vertices.end(), { r * std::sin(theta) * std::cos(phi), r * std::cos(theta), r * std::sin(theta) * std::sin(phi),
+                    (float)segment / segments, (float)ring / rings });
+            }
+        }
+        for (int ring = 0; ring < rings; ++ring) {
+            for (int segment = 0; segment < segments; ++segment) {
+                uint32_t a = ring * (segments + 1) + segment, b = a + segments + 1;
+                mesh->indices.insert(mesh->indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+            }
+        }
+        // Pole triangles collapse to nothing, drop them like an exporter would
+        std::vector<uint32_t> kept;
+        for (size_t i = 0; i < mesh->indices.size(); i += 3) {
+            const uint32_t* t = &mesh->indices[i];
+            glm::vec3 p[3];
+            for (int k = 0; k < 3; ++k)
+                p[k] = glm::vec3(mesh->vertices[t[k] * 5], mesh->vertices[t[k] * 5 + 1], mesh->vertices[t[k] * 5 + 2]);
+            if (glm::length(glm::cross(p[1] - p[0], p[2] - p[0])) > 1e-7f)
+                kept.insert(kept.end(), t, t + 3);
+        }
+        mesh->indices = kept;
+        std::vector<uint32_t> base = mesh->indices;
+
+        std::vector<float> targets = { 0.0025f, 0.01f, 0.04f };
+        BuildLods(*mesh, targets);
+        if (mesh->levels.size() < 2)
+            Bench::Fail("no level got simpler than full detail");
+
+        // Seam vertices (u == 0 or 1) the full mesh uses. The poles are one position with a u per segment,
+        // dropping some of those copies is fine.
+        std::vector<uint32_t> seam;
+        for (uint32_t index : base) {
+            float u = mesh->vertices[index * 5 + 3], v = mesh->vertices[index * 5 + 4];
+            if ((u == 0.0f || u == 1.0f) && v != 0.0f && v != 1.0f)
+                seam.push_back(index);
+        }
+        for (size_t l = 0; l < mesh->levels.size(); ++l) {
+            const LodLevel &level = mesh->levels[l];
+            std::vector<bool> used(mesh->VertexCount(), false);
+            for (uint32_t i = 0; i < level.index_count; ++i)
+                used[mesh->indices[level.index_offset + i]] = true;
+            for (uint32_t index : seam) {
+                if (!used[index]) {
+                    Bench::Fail("level " + std::to_string(l) + " moved a seam vertex");
+                    break;
+                }
+            }
+            float deviation = MaxDeviation(mesh->vertices.data(), 5, base.data(), base.size(), mesh->indices.data() + level.index_offset, level.index_count);
+            if (level.error < deviation)
+                Bench::Fail("level " + std::to_string(l) + " error under its measured deviation");
+
+            std::string prefix = "level" + std::to_string(l) + "_";
+            Bench::SetCounter(prefix + "triangles", level.index_count / 3);
+            Bench::SetCounter(prefix + "error", level.error);
+            Bench::SetCounter(prefix + "max_deviation", deviation);
+        }
+
+        // Round trip through the .lod format
+        LodMesh parsed;
+        std::vector<uint8_t> file = SerializeLodMesh(*mesh);
+        if (!ParseLodMesh(file, parsed) || parsed.indices != mesh->indices || parsed.levels.size() != mesh->levels.size())
+            Bench::Fail(".lod round trip changed the mesh");
+
+        return Bench::Body([mesh, base, targets](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                std::vector<uint32_t> indices = base;
+                std::vector<LodLevel> levels = BuildLods(mesh->vertices.data(), mesh->VertexCount(), 5, indices, targets);
+                Bench::DoNotOptimize(levels.data());
+            }
+        });
+    });
+}
+
+// A 256x256 field of chunk sized objects, 4 km across, with the camera walking through the middle
+struct LodScene {
+    std::vector<LodLevel> levels;
+    std::vector<float> deviations; // measured per level
+    float radius = 0.0f;
+    glm::vec3 offset = glm::vec3(0.0f); // bounding sphere center from the object's corner
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> current;
+    glm::mat4 projection;
+    glm::vec3 eye = glm::vec3(0.0f, 2.0f, 0.0f);
+
+    // Returns how many objects switched
+    unsigned int Frame(LodSelector &selector)
+    {
+        selector.Begin(eye, projection, LOD_VIEWPORT_HEIGHT);
+        for (size_t i = 0; i < positions.size(); ++i)
+            current[i] = selector.Select(levels, current[i], positions[i] + offset, radius);
+        return selector.Stats.switches;
+    }
+};
+
+static std::shared_ptr<LodScene> MakeLodScene()
+{
+    StreamingSettings settings;
+    ChunkData chunk = HillyChunk(settings.resolution, settings.lod_errors);
+
+    auto scene = std::make_shared<LodScene>();
+    scene->levels = chunk.lods;
+    for (const LodLevel &level : chunk.lods)
+        scene->deviations.push_back(LevelDeviation(chunk, level));
+    float half = settings.chunk_size * 0.5f;
+    float half_height = (chunk.max_height - chunk.min_height) * 0.5f;
+    scene->offset = glm::vec3(half, chunk.min_height + half_height, half);
+    scene->radius = glm::length(glm::vec3(half, half_height, half));
+
+    const int field = 256;
+    for (int z = 0; z < field; ++z) {
+        for (int x = 0; x < field; ++x)
+            scene->positions.push_back(glm::vec3((x - field / 2) * settings.chunk_size, 0.0f, (z - field / 2) * settings.chunk_size));
+    }
+    scene->current.assign(scene->positions.size(), 0);
+    scene->projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.01f, 1000.0f);
+    return scene;
+}
+
+// Switches over a walk that keeps stepping back and forth around slow progress, like a player idling at a spot
+static unsigned int CountSwitches(float hysteresis)
+{
+    std::shared_ptr<LodScene> scene = MakeLodScene();
+    LodSelector selector;
+    selector.Hysteresis = hysteresis;
+    scene->Frame(selector);
+
+    unsigned int switches = 0;
+    for (int frame = 0; frame < 120; ++frame) {
+        scene->eye = glm::vec3(0.05f * frame + 2.0f * std::sin(frame * 0.5f), 2.0f, 0.0f);
+        switches += scene->Frame(selector);
+    }
+    return switches;
+}
+
+static void RegisterSelectCase()
+{
+    // Per frame selection cost for 65k objects, and the triangles it saves
+    Bench::Register("lod/select_large_scene", false, [] {
+        std::shared_ptr<LodScene> scene = MakeLodScene();
+        auto selector = std::make_shared<LodSelector>();
+        scene->Frame(*selector);
+
+        // Nothing may be drawn coarser than the threshold allows, going by how far the level really is off
+        for (size_t i = 0; i < scene->positions.size(); ++i) {
+            float error = selector->ScreenError(scene->deviations[scene->current[i]], scene->positions[i] + scene->offset, scene->radius);
+            if (error > selector->ThresholdPixels) {
+                Bench::Fail("an object is drawn over the pixel threshold");
+                break;
+            }
+        }
+
+        unsigned int with_hysteresis = CountSwitches(0.25f);
+        unsigned int without_hysteresis = CountSwitches(0.0f);
+        Bench::SetCounter("switches_hysteresis", with_hysteresis);
+        Bench::SetCounter("switches_no_hysteresis", without_hysteresis);
+        if (with_hysteresis > without_hysteresis)
+            Bench::Fail("hysteresis switched levels more often than none");
+
+        return Bench::Body([scene, selector](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                scene->eye.x += 0.1f;
+                scene->Frame(*selector);
+            }
+
+            const LodStats &stats = selector->Stats;
+            Bench::SetCounter("objects", stats.objects);
+            Bench::SetCounter("full_triangles", (double)stats.full_triangles);
+            Bench::SetCounter("lod_triangles", (double)stats.triangles);
+            Bench::SetCounter("triangles_saved_percent", stats.full_triangles ? 100.0 * (1.0 - (double)stats.triangles / (double)stats.full_triangles) : 0.0);
+            if (stats.triangles >= stats.full_triangles)
+                Bench::Fail("LOD saved nothing");
+        });
+    });
+}
+
+void RegisterLodCases()
+{
+    RegisterSimplifyChunkCase();
+    RegisterSimplifySphereCase();
+    RegisterSelectCase();
+}
@@ -0,0 +1,185 @@
+/// GreyHeavens_bench
+///
+///   GreyHeavens_bench [--filter <substring>] [--samples <n>] [--warmup <n>]
+///                     [--min-sample-ms <ms>] [--no-gl] [--out <results.json>]
+///   GreyHeavens_bench --compare <base.json> <new.json> [--threshold <0.05>] [--alpha <0.01>]
+///
+/// No window. Cases that need GL get a context from SDL's offscreen video
+/// driver (EGL, no window system at all), falling back to a hidden window.
+/// If neither works the GL cases are skipped, the rest still runs.
+///
+/// Exit code is non-zero when a case fails its own checks, or, with
+/// --compare, when a regression is flagged.
+
+#include <SDL3/SDL.h>
+#include <glad/glad.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <Utils/vfs.hpp>
+
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static SDL_Window *window = NULL;
+static SDL_GLContext gl_context = NULL;
+
+static bool CreateOffscreenContext()
+{
+    const char* drivers[] = { "offscreen", NULL };
+
+    for (const char* driver : drivers) {
+        if (driver)
+            SDL_SetHint(SDL_HINT_VIDEO_DRIVER, driver);
+        else
+            SDL_ResetHint(SDL_HINT_VIDEO_DRIVER);
+
+        if (!SDL_Init(SDL_INIT_VIDEO))
+            continue;
+
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 6);
+
+        // Never shown, we only need something to make the context current on
+        window = SDL_CreateWindow("GreyHeavens_bench", 64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+        if (window)
+            gl_context = SDL_GL_CreateContext(window);
+        if (gl_context && gladLoadGLLoader((GLADloadproc)SDL_GL_GetProcAddress)) {
+            SDL_GL_SetSwapInterval(0);
+            return true;
+        }
+
+        if (gl_context)
+            SDL_GL_DestroyContext(gl_context);
+        if (window)
+            SDL_DestroyWindow(window);
+        gl_context = NULL;
+        window = NULL;
+        SDL_Quit();
+    }
+    return false;
+}
+
+static void DestroyOffscreenContext()
+{
+    if (gl_context)
+        SDL_GL_DestroyContext(gl_context);
+    if (window)
+        SDL_DestroyWindow(window);
+    SDL_Quit();
+}
+
+static int RunCompare(int argc, char* argv[])
+{
+    Bench::CompareOptions options;
+    std::vector<std::string> files;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            options.threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc)
+            options.alpha = atof(argv[++i]);
+        else
+            files.push_back(argv[i]);
+    }
+
+    if (files.size() != 2) {
+        std::cout << "Usage: GreyHeavens_bench --compare <base.json> <new.json> [--threshold 0.05] [--alpha 0.01]" << std::endl;
+        return 2;
+    }
+
+    std::vector<Bench::Result> base, current;
+    if (!Bench::ReadJson(files[0], base) || !Bench::ReadJson(files[1], current)) {
+        std::cout << "Couldn't read " << files[0] << " or " << files[1] << std::endl;
+        return 2;
+    }
+
+    int regressions = Bench::Compare(base, current, options);
+    std::cout << regressions << " regression(s), threshold " << options.threshold * 100.0
+              << "%, alpha " << options.alpha << std::endl;
+    return regressions > 0 ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], "--compare") == 0)
+        return RunCompare(argc, argv);
+
+    Bench::Options options;
+    std::string out_path = "bench_results.json";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--filter" && has_value)
+            options.filter = argv[++i];
+        else if (arg == "--samples" && has_value)
+            options.samples = std::max(atoi(argv[++i]), 2);
+        else if (arg == "--warmup" && has_value)
+            options.warmup = std::max(atoi(argv[++i]), 0);
+        else if (arg == "--min-sample-ms" && has_value)
+            options.min_sample_ms = atof(argv[++i]);
+        else if (arg == "--out" && has_value)
+            out_path = argv[++i];
+        else if (arg == "--no-gl")
+            options.gl = false;
+        else {
+            std::cout << "Unknown argument: " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    // Same files the game reads, straight from the source tree
+    GetFileSystem().MountDirectory(GREYHEAVENS_BENCH_ASSET_DIR);
+
+    RegisterEngineCases();
+    RegisterLightingCases();
+    RegisterWorldCases();
+    RegisterParticleCases();
+    RegisterDebugDrawCases();
+    RegisterLodCases();
+    RegisterResourceCases();
+
+    bool needs_gl = false;
+    for (const Bench::Case &bench_case : Bench::Registry()) {
+        if (bench_case.needs_gl && bench_case.name.find(options.filter) != std::string::npos)
+            needs_gl = true;
+    }
+    bool has_gl = options.gl && needs_gl && CreateOffscreenContext();
+    if (options.gl && needs_gl && !has_gl)
+        std::cout << "No offscreen GL context (" << SDL_GetError() << "), skipping GL cases" << std::endl;
+    if (has_gl)
+        std::cout << "GL: " << glGetString(GL_RENDERER) << ", " << glGetString(GL_VERSION) << std::endl;
+
+    std::vector<Bench::Result> results;
+    int failures = 0;
+    for (const Bench::Case &bench_case : Bench::Registry()) {
+        if (bench_case.name.find(options.filter) == std::string::npos)
+            continue;
+        if (bench_case.needs_gl && !has_gl)
+            continue;
+
+        results.push_back(Bench::Run(bench_case, options));
+        Bench::PrintResult(results.back());
+        if (!results.back().failure.empty())
+            ++failures;
+    }
+
+    std::ofstream out(out_path);
+    if (out) {
+        Bench::WriteJson(out, results, options);
+        std::cout << "Wrote " << out_path << std::endl;
+    }
+    else {
+        std::cout << "Couldn't write " << out_path << std::endl;
+    }
+
+    if (has_gl)
+        DestroyOffscreenContext();
+    return failures > 0 ? 1 : 0;
+}
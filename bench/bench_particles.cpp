@@ -0,0 +1,106 @@
+/// Particles: SoA update and packing at a million live particles
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Utils/particles.hpp>
+
+#include "bench.hpp"
+
+#include <memory>
+#include <string>
+
+const size_t PARTICLE_TARGET = 1000000;
+const float PARTICLE_STEP = 1.0f / 60.0f;
+
+// Emits exactly enough to hold the pool at about `alive` particles
+static std::shared_ptr<ParticleSystem> SteadyParticles(size_t alive, bool simd, unsigned int max_threads, Particle_Blend blend)
+{
+    auto particles = std::make_shared<ParticleSystem>(alive + alive / 8);
+    particles->UseSIMD = simd;
+    particles->MaxThreads = max_threads;
+    particles->Blend = blend;
+
+    ParticleEmitter emitter;
+    emitter.velocity = glm::vec3(0.0f, 6.0f, 0.0f);
+    emitter.spread = 2.0f;
+    emitter.lifetime = 2.0f;
+    emitter.rate = (float)alive / emitter.lifetime;
+    particles->Emitters.push_back(emitter);
+
+    // Past the first lifetime, emission and deaths even out
+    for (int frame = 0; frame < 150; ++frame)
+        particles->Update(PARTICLE_STEP);
+    return particles;
+}
+
+static void RegisterUpdateCase(bool simd, unsigned int max_threads)
+{
+    std::string name = "particles/update_1m";
+    if (!simd)
+        name += "_scalar";
+    if (max_threads == 1)
+        name += "_single_thread";
+
+    Bench::Register(name, false, [simd, max_threads] {
+        auto particles = SteadyParticles(PARTICLE_TARGET, simd, max_threads, PARTICLE_ADDITIVE);
+        if (particles->Count() < PARTICLE_TARGET * 9 / 10)
+            Bench::Fail("pool did not reach a steady state");
+
+        return Bench::Body([particles](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                particles->Update(PARTICLE_STEP);
+                Bench::DoNotOptimize(particles->Stats.alive);
+            }
+            Bench::SetCounter("alive", particles->Stats.alive);
+            Bench::SetCounter("died_per_frame", particles->Stats.died);
+            Bench::SetCounter("dropped_per_frame", particles->Stats.dropped);
+        });
+    });
+}
+
+static void RegisterPackCase(size_t alive, Particle_Blend blend)
+{
+    std::string name = "particles/pack_" + std::to_string(alive / 1000) + "k";
+    if (blend == PARTICLE_ALPHA)
+        name += "_sorted";
+
+    Bench::Register(name, false, [alive, blend] {
+        auto particles = SteadyParticles(alive, true, 0, blend);
+        glm::vec3 eye(0.0f, 2.0f, 10.0f);
+        glm::vec3 front = glm::normalize(glm::vec3(0.0f, 0.0f, -1.0f));
+
+        // Once outside the timing, to check the order
+        particles->Pack(eye, front);
+        if (blend == PARTICLE_ALPHA) {
+            const std::vector<ParticleInstance> &instances = particles->Instances();
+            for (size_t i = 1; i < instances.size(); ++i) {
+                float previous = glm::dot(glm::vec3(instances[i - 1].x, instances[i - 1].y, instances[i - 1].z) - eye, front);
+                float current = glm::dot(glm::vec3(instances[i].x, instances[i].y, instances[i].z) - eye, front);
+                if (current > previous + 1e-3f) {
+                    Bench::Fail("particles not sorted back to front");
+                    break;
+                }
+            }
+        }
+
+        return Bench::Body([particles, eye, front](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                particles->Pack(eye, front);
+                Bench::DoNotOptimize(particles->Instances().data());
+            }
+            Bench::SetCounter("instances", particles->Instances().size());
+            Bench::SetCounter("instance_mb", particles->Instances().size() * sizeof(ParticleInstance) / (1024.0 * 1024.0));
+        });
+    });
+}
+
+void RegisterParticleCases()
+{
+    RegisterUpdateCase(true, 0);
+    RegisterUpdateCase(false, 0); // what SSE2 buys us
+    RegisterUpdateCase(true, 1);  // what the job system buys us
+
+    RegisterPackCase(PARTICLE_TARGET, PARTICLE_ADDITIVE);
+    RegisterPackCase(100000, PARTICLE_ALPHA);
+}
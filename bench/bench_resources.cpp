@@ -0,0 +1,112 @@
+/// Resource manager: a texture going cold under a budget, losing mips, getting evicted and coming back
+
+#include <glad/glad.h>
+
+#include <Utils/resource_manager.hpp>
+
+#include "bench.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+const int RESOURCE_TEXTURE_SIZE = 256;
+
+// Same math as ResourceManager::textureBytes for a square RGBA8 texture with its top levels gone
+static size_t MipChainBytes(int size, int dropped_levels)
+{
+    size_t bytes = 0;
+    for (int level_size = size >> dropped_levels; level_size > 0; level_size >>= 1)
+        bytes += (size_t)level_size * level_size * 4;
+    return bytes;
+}
+
+static void CheckStats(const ResourceStats &stats, uint32_t resident, uint32_t degraded, uint32_t evicted,
+    size_t resident_bytes, size_t evicted_bytes, uint32_t reloads, const std::string &stage)
+{
+    if (stats.resident_textures != resident || stats.degraded_textures != degraded || stats.evicted_textures != evicted)
+        Bench::Fail(stage + ": wrong resident/degraded/evicted counts");
+    if (stats.resident_texture_bytes != resident_bytes || stats.evicted_texture_bytes != evicted_bytes)
+        Bench::Fail(stage + ": wrong resident/evicted bytes");
+    if (stats.reloads != reloads)
+        Bench::Fail(stage + ": wrong reload count");
+}
+
+static void RegisterEvictionCase()
+{
+    // Two evictable textures, one drawn every frame and one nobody looks at. Its own manager,
+    // so the counts are not mixed up with whatever else lives in GetResourceManager().
+    Bench::Register("resources/evict_reload", true, [] {
+        std::shared_ptr<ResourceManager> resources(new ResourceManager(), [](ResourceManager* resources) {
+            resources->ReleaseAll();
+            delete resources;
+        });
+        auto loads = std::make_shared<uint32_t>(0);
+
+        TextureDesc desc;
+        desc.width = RESOURCE_TEXTURE_SIZE;
+        desc.height = RESOURCE_TEXTURE_SIZE;
+        desc.levels = 9;
+        TextureLoader loader = [loads](GLuint texture, const TextureDesc &desc) {
+            std::vector<unsigned char> rgba((size_t)desc.width * desc.height * 4);
+            for (size_t i = 0; i < rgba.size(); ++i)
+                rgba[i] = (unsigned char)(i * 7);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, desc.width, desc.height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            ++*loads;
+            return true;
+        };
+        ResourceHandle hot = resources->CreateTexture(desc, loader);
+        ResourceHandle cold = resources->CreateTexture(desc, loader);
+
+        size_t full = MipChainBytes(RESOURCE_TEXTURE_SIZE, 0);
+        size_t one_dropped = MipChainBytes(RESOURCE_TEXTURE_SIZE, 1);
+        CheckStats(resources->Query(), 2, 0, 0, 2 * full, 0, 0, "created");
+
+        // Room for one and a bit, the cold one only has to lose its top level
+        resources->SetTextureBudget(full + one_dropped);
+        for (uint64_t frame = 0; frame < EVICTION_COLD_FRAMES; ++frame) {
+            resources->Get(hot);
+            resources->BeginFrame();
+        }
+        CheckStats(resources->Query(), 2, 1, 0, full + one_dropped, 0, 0, "mip dropped");
+
+        // Room for one, dropping stops at EVICTION_MIN_SIZE and the rest goes
+        resources->SetTextureBudget(full);
+        resources->Get(hot);
+        resources->BeginFrame();
+        CheckStats(resources->Query(), 1, 0, 1, full, full, 0, "evicted");
+
+        // Back at full size, through the loader
+        GLuint texture = resources->Get(cold);
+        CheckStats(resources->Query(), 2, 0, 0, 2 * full, 0, 1, "reloaded");
+        GLint width = 0, levels = 0;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+        if (texture == 0 || width != desc.width || levels != desc.levels)
+            Bench::Fail("reloaded texture is not at full resolution");
+        if (*loads != 3)
+            Bench::Fail("loader ran " + std::to_string(*loads) + " times, expected 3");
+
+        // One op: the cold texture ages out, gets evicted and is reloaded
+        return Bench::Body([resources, hot, cold, loads](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                for (uint64_t frame = 0; frame < EVICTION_COLD_FRAMES; ++frame) {
+                    resources->Get(hot);
+                    resources->BeginFrame();
+                }
+                resources->Get(cold);
+            }
+            glFinish();
+            Bench::SetCounter("reloads", resources->Query().reloads);
+            Bench::SetCounter("loads", *loads);
+        });
+    });
+}
+
+void RegisterResourceCases()
+{
+    RegisterEvictionCase();
+}
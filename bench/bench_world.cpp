@@ -0,0 +1,132 @@
+/// World streaming: a headless fly-through over the chunked ground
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Utils/world_streaming.hpp>
+
+#include "bench.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// What a chunk read from a slow disk would cost, on top of generating it
+const int SIMULATED_IO_MS = 20;
+
+// Loads can only finish between frames. A frame that waits on a load never
+// lets the gate open, the load gives up after a while and the case fails.
+// Wall clock thresholds would be flaky, a busy machine stalls threads on its own.
+struct LoadGate {
+    std::mutex mutex;
+    std::condition_variable opened;
+    uint64_t openings = 0;
+    bool released = false; // case is over, let the stragglers through
+    bool timed_out = false;
+    bool ran_on_main_thread = false;
+    std::thread::id main_thread = std::this_thread::get_id();
+
+    void Open()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++openings;
+        }
+        opened.notify_all();
+    }
+
+    void Release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            released = true;
+        }
+        opened.notify_all();
+    }
+
+    void Pass()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (std::this_thread::get_id() == main_thread)
+            ran_on_main_thread = true;
+        uint64_t seen = openings;
+        if (!opened.wait_for(lock, std::chrono::seconds(2), [&] { return openings != seen || released; }))
+            timed_out = true;
+    }
+};
+
+static void RegisterFlyThroughCase()
+{
+    // Main thread cost of Update() + Upload() per frame while flying at 20 units/s.
+    // The path follows wall clock time, frames just come faster than 60 fps.
+    Bench::Register("world/fly_through", false, [] {
+        StreamingSettings settings;
+        settings.gl = false;
+
+        auto gate = std::make_shared<LoadGate>();
+        ChunkLoader slow_loader = [gate](ChunkCoord coord, const StreamingSettings &settings, ChunkData &out) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(SIMULATED_IO_MS));
+            gate->Pass();
+            return GenerateChunk(coord, settings, out);
+        };
+
+        struct Flight {
+            WorldStreamer world;
+            std::shared_ptr<LoadGate> gate;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            double worst_frame_ms = 0.0;
+            double upload_bytes = 0.0;
+            uint64_t frames = 0;
+
+            Flight(StreamingSettings settings, ChunkLoader loader, std::shared_ptr<LoadGate> gate) : world(settings, loader), gate(gate) {}
+            ~Flight() { gate->Release(); }
+        };
+        auto flight = std::make_shared<Flight>(settings, slow_loader, gate);
+
+        return Bench::Body([flight, gate](uint64_t iterations) {
+            for (uint64_t it = 0; it < iterations; ++it) {
+                // Big lazy circle, so the view direction keeps changing
+                float time = std::chrono::duration<float>(std::chrono::steady_clock::now() - flight->start).count();
+                float angle = time * 0.05f;
+                glm::vec3 position(std::cos(angle) * 400.0f, 2.0f, std::sin(angle) * 400.0f);
+                glm::vec3 front(-std::sin(angle), 0.0f, std::cos(angle));
+
+                flight->world.Update(position, front);
+                flight->world.Upload();
+                gate->Open();
+
+                // Every frame, the cap holds at all times and not just when the sample ends
+                const StreamingStats &stats = flight->world.Stats;
+                if (stats.resident_bytes > flight->world.Settings.memory_cap)
+                    Bench::Fail("resident memory over the cap");
+                if (stats.in_flight > flight->world.Settings.max_in_flight)
+                    Bench::Fail("more loads in flight than max_in_flight");
+                flight->worst_frame_ms = std::max(flight->worst_frame_ms, stats.update_ms);
+                flight->upload_bytes += (double)stats.upload_bytes;
+                ++flight->frames;
+            }
+
+            const StreamingStats &stats = flight->world.Stats;
+            Bench::SetCounter("resident_chunks", stats.resident_chunks);
+            Bench::SetCounter("resident_mb", stats.resident_bytes / (1024.0 * 1024.0));
+            Bench::SetCounter("average_load_ms", stats.average_load_ms);
+            Bench::SetCounter("max_load_ms", stats.max_load_ms);
+            Bench::SetCounter("upload_bytes_per_frame", flight->upload_bytes / (double)std::max<uint64_t>(flight->frames, 1));
+            Bench::SetCounter("worst_frame_ms", flight->worst_frame_ms);
+
+            std::lock_guard<std::mutex> lock(gate->mutex);
+            if (gate->timed_out)
+                Bench::Fail("a frame waited on a chunk load");
+            if (gate->ran_on_main_thread)
+                Bench::Fail("a chunk was loaded on the main thread");
+        });
+    });
+}
+
+void RegisterWorldCases()
+{
+    RegisterFlyThroughCase();
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Just enough JSON to read back our own result files. No unicode escapes
+/// beyond passing them through, no streaming.
+namespace Json {
+
+enum Value_Type {
+    JSON_NULL,
+    JSON_BOOL,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT
+};
+
+struct Value {
+    Value_Type type = JSON_NULL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Value> array;
+    std::vector<std::pair<std::string, Value>> object;
+
+    // nullptr if missing or not an object
+    const Value* Find(const std::string &key) const
+    {
+        for (const auto &member : object) {
+            if (member.first == key)
+                return &member.second;
+        }
+        return nullptr;
+    }
+
+    double NumberOr(const std::string &key, double fallback) const
+    {
+        const Value* value = Find(key);
+        return value && value->type == JSON_NUMBER ? value->number : fallback;
+    }
+
+    std::string StringOr(const std::string &key, const std::string &fallback) const
+    {
+        const Value* value = Find(key);
+        return value && value->type == JSON_STRING ? value->string : fallback;
+    }
+};
+
+class Parser
+{
+public:
+    Parser(const std::string &text) : text(text) {}
+
+    bool Parse(Value &out)
+    {
+        position = 0;
+        if (!parseValue(out))
+            return false;
+        skipWhitespace();
+        return position == text.size();
+    }
+
+private:
+    const std::string &text;
+    size_t position = 0;
+
+    void skipWhitespace()
+    {
+        while (position < text.size() && isspace((unsigned char)text[position]))
+            ++position;
+    }
+
+    bool consume(char c)
+    {
+        skipWhitespace();
+        if (position < text.size() && text[position] == c) {
+            ++position;
+            return true;
+        }
+        return false;
+    }
+
+    bool literal(const char* word)
+    {
+        size_t length = strlen(word);
+        if (text.compare(position, length, word) != 0)
+            return false;
+        position += length;
+        return true;
+    }
+
+    bool parseValue(Value &out)
+    {
+        skipWhitespace();
+        if (position >= text.size())
+            return false;
+
+        char c = text[position];
+        if (c == '{')
+            return parseObject(out);
+        if (c == '[')
+            return parseArray(out);
+        if (c == '"') {
+            out.type = JSON_STRING;
+            return parseString(out.string);
+        }
+        if (literal("true")) {
+            out.type = JSON_BOOL;
+            out.boolean = true;
+            return true;
+        }
+        if (literal("false")) {
+            out.type = JSON_BOOL;
+            return true;
+        }
+        if (literal("null")) {
+            out.type = JSON_NULL;
+            return true;
+        }
+
+        const char* start = text.c_str() + position;
+        char* end = nullptr;
+        out.number = strtod(start, &end);
+        if (end == start)
+            return false;
+        out.type = JSON_NUMBER;
+        position += (size_t)(end - start);
+        return true;
+    }
+
+    bool parseString(std::string &out)
+    {
+        if (!consume('"'))
+            return false;
+        out.clear();
+        while (position < text.size()) {
+            char c = text[position++];
+            if (c == '"')
+                return true;
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (position >= text.size())
+                return false;
+            char escaped = text[position++];
+            switch (escaped) {
+            case 'n': out.push_back('\n'); break;
+            case 't': out.push_back('\t'); break;
+            case 'r': out.push_back('\r'); break;
+            case 'u': out += "\\u"; break;
+            default:  out.push_back(escaped); break;
+            }
+        }
+        return false;
+    }
+
+    bool parseArray(Value &out)
+    {
+        out.type = JSON_ARRAY;
+        consume('[');
+        if (consume(']'))
+            return true;
+        do {
+            out.array.emplace_back();
+            if (!parseValue(out.array.back()))
+                return false;
+        } while (consume(','));
+        return consume(']');
+    }
+
+    bool parseObject(Value &out)
+    {
+        out.type = JSON_OBJECT;
+        consume('{');
+        if (consume('}'))
+            return true;
+        do {
+            std::string key;
+            skipWhitespace();
+            if (!parseString(key) || !consume(':'))
+                return false;
+            out.object.emplace_back(key, Value());
+            if (!parseValue(out.object.back().second))
+                return false;
+        } while (consume(','));
+        return consume('}');
+    }
+};
+
+// Escapes for writing
+inline std::string Escape(const std::string &text)
+{
+    std::string out;
+    for (char c : text) {
+        switch (c) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:   out.push_back(c); break;
+        }
+    }
+    return out;
+}
+
+}
@@ -0,0 +1,413 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <Utils/job_system.hpp>
+#include <Utils/resource_manager.hpp>
+#include <Utils/shader.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/// Clustered forward lighting
+///
+/// The view frustum is cut into CLUSTER_X * CLUSTER_Y screen tiles and
+/// CLUSTER_Z exponential depth slices (froxels). Every frame the CPU works out
+/// which lights touch which froxel, on the job system, and uploads
+/// - the lights, in view space
+/// - one (offset, count) pair per froxel
+/// - the light index lists, packed back to back
+/// Fragment shaders find their froxel from gl_FragCoord and view depth and only
+/// walk that list, see shaders/basic/lighting.glsl.
+///
+/// A froxel keeps at most MAX_LIGHTS_PER_CLUSTER lights, that is what bounds
+/// the per fragment cost no matter how many lights the scene has. Lights past
+/// the cap are dropped (in submission order) and counted in ClusterStats.
+
+// Keep in sync with lighting.glsl
+const unsigned int CLUSTER_X = 16;
+const unsigned int CLUSTER_Y = 9;
+const unsigned int CLUSTER_Z = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+const unsigned int MAX_LIGHTS_PER_CLUSTER = 64;
+
+const unsigned int LIGHT_BINDING = 2;
+const unsigned int CLUSTER_BINDING = 3;
+const unsigned int LIGHT_INDEX_BINDING = 4;
+
+// Depth slices are exponential from here on, anything closer lands in slice 0.
+// Starting at the real near plane (0.01) would waste half the slices on the first meter.
+const float CLUSTER_NEAR = 0.1f;
+
+enum Light_Type {
+    LIGHT_POINT,
+    LIGHT_SPOT
+};
+
+struct Light {
+    Light_Type type = LIGHT_POINT;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 color = glm::vec3(1.0f);
+    float intensity = 1.0f;
+    float radius = 5.0f;                               // no contribution past this
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f); // spot only
+    float inner_angle = 0.3f;                          // spot only, radians from the axis
+    float outer_angle = 0.5f;
+};
+
+// Mirrors `struct Light` in lighting.glsl (std430)
+// Point lights get cos_outer = -2, cos_inner = -1 so the spot term is always 1.
+struct GPULight {
+    glm::vec4 position_radius;     // view space
+    glm::vec4 direction_cos_outer; // view space
+    glm::vec4 color_cos_inner;     // color already multiplied by intensity
+};
+
+struct ClusterStats {
+    unsigned int lights = 0;
+    unsigned int visible_lights = 0;    // touched at least one froxel
+    unsigned int light_indices = 0;     // total across all froxels
+    unsigned int max_cluster_lights = 0;
+    unsigned int overflowed_clusters = 0;
+    double assign_ms = 0.0;
+};
+
+class ClusteredLighting
+{
+public:
+    glm::vec3 Ambient = glm::vec3(0.15f);
+    // Threads that take part in assignment, 0 is the whole job system
+    unsigned int MaxThreads = 0;
+    ClusterStats Stats;
+
+    void Init()
+    {
+        ResourceManager &resources = GetResourceManager();
+        light_SSBO = resources.CreateBuffer(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+        cluster_SSBO = resources.CreateBuffer(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+        index_SSBO = resources.CreateBuffer(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+    }
+
+    // CPU half of Update(), no GL calls. Needs a symmetric perspective projection.
+    void Assign(const glm::mat4 &view, const glm::mat4 &projection, float near_plane, float far_plane, const std::vector<Light> &lights)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        rebuildGrid(projection, near_plane, far_plane);
+
+        size_t count = lights.size();
+        gpu_lights.resize(count);
+        light_bounds.resize(count);
+        cluster_counts.assign(CLUSTER_COUNT, 0);
+        cluster_lights.resize((size_t)CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER);
+
+        JobSystem &jobs = GetJobSystem();
+
+        // 1. View space lights and the froxel range each one can touch
+        jobs.ParallelFor(count, 256, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                prepareLight(view, lights[i], gpu_lights[i], light_bounds[i]);
+        }, MaxThreads);
+
+        // 2. Bin by depth slice, so a row of froxels only looks at lights that reach its slice
+        for (std::vector<uint32_t> &slice : slice_lights)
+            slice.clear();
+        for (size_t i = 0; i < count; ++i) {
+            const LightBounds &bounds = light_bounds[i];
+            for (int z = bounds.min.z; z <= bounds.max.z; ++z)
+                slice_lights[z].push_back((uint32_t)i);
+        }
+
+        // 3. Exact sphere / froxel tests. One row (y, z) is only ever written by one thread.
+        std::vector<uint8_t> touched(count, 0);
+        jobs.ParallelFor(CLUSTER_Y * CLUSTER_Z, 8, [&](size_t begin, size_t end) {
+            for (size_t row = begin; row < end; ++row)
+                assignRow((unsigned int)(row % CLUSTER_Y), (unsigned int)(row / CLUSTER_Y), touched);
+        }, MaxThreads);
+
+        // 4. Pack the fixed size lists back to back
+        cluster_ranges.resize(CLUSTER_COUNT);
+        light_indices.clear();
+        Stats = ClusterStats();
+        Stats.lights = (unsigned int)count;
+        for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; ++cluster) {
+            uint32_t lights_here = std::min(cluster_counts[cluster], MAX_LIGHTS_PER_CLUSTER);
+            cluster_ranges[cluster] = { (uint32_t)light_indices.size(), lights_here };
+            const uint32_t* list = &cluster_lights[(size_t)cluster * MAX_LIGHTS_PER_CLUSTER];
+            light_indices.insert(light_indices.end(), list, list + lights_here);
+
+            Stats.max_cluster_lights = std::max(Stats.max_cluster_lights, lights_here);
+            if (cluster_counts[cluster] > MAX_LIGHTS_PER_CLUSTER)
+                ++Stats.overflowed_clusters;
+        }
+        for (uint8_t hit : touched)
+            Stats.visible_lights += hit;
+        Stats.light_indices = (unsigned int)light_indices.size();
+
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        Stats.assign_ms = elapsed.count();
+    }
+
+    void Upload()
+    {
+        ResourceManager &resources = GetResourceManager();
+
+        // Never zero sized, an unbacked SSBO binding is an error on some drivers
+        GPULight no_light = {};
+        uint32_t no_index = 0;
+        resources.BufferData(light_SSBO, GL_SHADER_STORAGE_BUFFER,
+            std::max<size_t>(gpu_lights.size(), 1) * sizeof(GPULight), gpu_lights.empty() ? &no_light : (const void*)gpu_lights.data(), GL_STREAM_DRAW);
+        resources.BufferData(cluster_SSBO, GL_SHADER_STORAGE_BUFFER,
+            cluster_ranges.size() * sizeof(ClusterRange), cluster_ranges.data(), GL_STREAM_DRAW);
+        resources.BufferData(index_SSBO, GL_SHADER_STORAGE_BUFFER,
+            std::max<size_t>(light_indices.size(), 1) * sizeof(uint32_t), light_indices.empty() ? &no_index : (const void*)light_indices.data(), GL_STREAM_DRAW);
+    }
+
+    void Update(const glm::mat4 &view, const glm::mat4 &projection, float near_plane, float far_plane, const std::vector<Light> &lights)
+    {
+        Assign(view, projection, near_plane, far_plane, lights);
+        Upload();
+    }
+
+    void Bind()
+    {
+        ResourceManager &resources = GetResourceManager();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING, resources.Get(light_SSBO));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BINDING, resources.Get(cluster_SSBO));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_INDEX_BINDING, resources.Get(index_SSBO));
+    }
+
+    // Per frame, the tile lookup depends on the viewport size
+    void SetUniforms(Shader &shader, int viewport_width, int viewport_height) const
+    {
+        shader.setVec2("cluster_screen_scale", (float)CLUSTER_X / (float)std::max(viewport_width, 1), (float)CLUSTER_Y / (float)std::max(viewport_height, 1));
+        shader.setFloat("cluster_z_scale", z_scale);
+        shader.setFloat("cluster_z_bias", z_bias);
+        shader.setVec3("ambient", Ambient);
+    }
+
+    void Release()
+    {
+        ResourceManager &resources = GetResourceManager();
+        resources.Release(light_SSBO);
+        resources.Release(cluster_SSBO);
+        resources.Release(index_SSBO);
+        light_SSBO = cluster_SSBO = index_SSBO = ResourceHandle();
+    }
+
+private:
+    struct ClusterRange {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    struct AABB {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    struct LightBounds {
+        glm::vec3 center; // view space bounding sphere
+        float radius;
+        glm::ivec3 min;   // froxel range, empty when min > max
+        glm::ivec3 max;
+    };
+
+    ResourceHandle light_SSBO;
+    ResourceHandle cluster_SSBO;
+    ResourceHandle index_SSBO;
+
+    // Grid, rebuilt when the projection changes
+    glm::mat4 grid_projection = glm::mat4(0.0f);
+    float grid_near = 0.0f;
+    float grid_far = 0.0f;
+    float z_scale = 0.0f;
+    float z_bias = 0.0f;
+    std::vector<AABB> cluster_bounds;
+    std::vector<AABB> row_bounds; // every froxel of a (y, z) row
+
+    std::vector<GPULight> gpu_lights;
+    std::vector<LightBounds> light_bounds;
+    std::vector<uint32_t> slice_lights[CLUSTER_Z];
+    std::vector<uint32_t> cluster_counts;
+    std::vector<uint32_t> cluster_lights;
+    std::vector<ClusterRange> cluster_ranges;
+    std::vector<uint32_t> light_indices;
+
+    float sliceDepth(unsigned int slice) const
+    {
+        if (slice == 0)
+            return grid_near;
+        return CLUSTER_NEAR * std::pow(grid_far / CLUSTER_NEAR, (float)slice / (float)CLUSTER_Z);
+    }
+
+    // Same formula as lighting.glsl
+    int sliceOf(float depth) const
+    {
+        if (depth <= CLUSTER_NEAR)
+            return 0;
+        int slice = (int)std::floor(std::log(depth) * z_scale + z_bias);
+        return std::clamp(slice, 0, (int)CLUSTER_Z - 1);
+    }
+
+    void rebuildGrid(const glm::mat4 &projection, float near_plane, float far_plane)
+    {
+        bool same = !cluster_bounds.empty() && near_plane == grid_near && far_plane == grid_far;
+        for (int column = 0; same && column < 4; ++column)
+            same = projection[column] == grid_projection[column];
+        if (same)
+            return;
+
+        grid_projection = projection;
+        grid_near = near_plane;
+        grid_far = std::max(far_plane, CLUSTER_NEAR * 2.0f);
+        z_scale = (float)CLUSTER_Z / std::log(grid_far / CLUSTER_NEAR);
+        z_bias = -z_scale * std::log(CLUSTER_NEAR);
+
+        // View space point for NDC (x, y) at a given depth
+        float inverse_x = 1.0f / projection[0][0];
+        float inverse_y = 1.0f / projection[1][1];
+
+        cluster_bounds.resize(CLUSTER_COUNT);
+        row_bounds.resize(CLUSTER_Y * CLUSTER_Z);
+        for (unsigned int z = 0; z < CLUSTER_Z; ++z) {
+            float depths[2] = { sliceDepth(z), sliceDepth(z + 1) };
+            for (unsigned int y = 0; y < CLUSTER_Y; ++y) {
+                float ndc_y[2] = { -1.0f + 2.0f * y / CLUSTER_Y, -1.0f + 2.0f * (y + 1) / CLUSTER_Y };
+                for (unsigned int x = 0; x < CLUSTER_X; ++x) {
+                    float ndc_x[2] = { -1.0f + 2.0f * x / CLUSTER_X, -1.0f + 2.0f * (x + 1) / CLUSTER_X };
+
+                    AABB bounds = { glm::vec3(INFINITY), glm::vec3(-INFINITY) };
+                    for (float depth : depths) {
+                        for (float px : ndc_x) {
+                            for (float py : ndc_y) {
+                                glm::vec3 corner(px * depth * inverse_x, py * depth * inverse_y, -depth);
+                                bounds.min = glm::min(bounds.min, corner);
+                                bounds.max = glm::max(bounds.max, corner);
+                            }
+                        }
+                    }
+                    cluster_bounds[x + CLUSTER_X * (y + CLUSTER_Y * z)] = bounds;
+
+                    AABB &row = row_bounds[y + CLUSTER_Y * z];
+                    row.min = x == 0 ? bounds.min : glm::min(row.min, bounds.min);
+                    row.max = x == 0 ? bounds.max : glm::max(row.max, bounds.max);
+                }
+            }
+        }
+    }
+
+    void prepareLight(const glm::mat4 &view, const Light &light, GPULight &gpu, LightBounds &bounds) const
+    {
+        glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        glm::vec3 direction = glm::normalize(glm::vec3(view * glm::vec4(light.direction, 0.0f)));
+
+        float cos_outer = -2.0f;
+        float cos_inner = -1.0f;
+        bounds.center = position;
+        bounds.radius = light.radius;
+
+        if (light.type == LIGHT_SPOT) {
+            float outer = std::clamp(light.outer_angle, 0.01f, glm::pi<float>() * 0.5f);
+            float inner = std::clamp(light.inner_angle, 0.0f, outer * 0.999f);
+            cos_outer = std::cos(outer);
+            cos_inner = std::cos(inner);
+
+            // Tightest sphere around the cone, much smaller than the full radius for narrow spots
+            if (outer <= glm::pi<float>() * 0.25f) {
+                bounds.radius = light.radius / (2.0f * cos_outer);
+                bounds.center = position + direction * bounds.radius;
+            }
+            else {
+                bounds.center = position + direction * (light.radius * cos_outer);
+                bounds.radius = light.radius * std::sin(outer);
+            }
+        }
+
+        gpu.position_radius = glm::vec4(position, light.radius);
+        gpu.direction_cos_outer = glm::vec4(direction, cos_outer);
+        gpu.color_cos_inner = glm::vec4(light.color * light.intensity, cos_inner);
+
+        // Empty range unless something below says otherwise
+        bounds.min = glm::ivec3(1);
+        bounds.max = glm::ivec3(0);
+
+        const glm::vec3 &center = bounds.center;
+        float radius = bounds.radius;
+        float closest = -(center.z + radius);
+        float farthest = -(center.z - radius);
+        if (farthest < grid_near || closest > grid_far || radius <= 0.0f)
+            return;
+
+        int min_x = 0, max_x = CLUSTER_X - 1;
+        int min_y = 0, max_y = CLUSTER_Y - 1;
+
+        // Fully in front of the near plane: project the corners of its box, the
+        // screen rect they span holds the sphere. Otherwise keep every tile.
+        if (closest > grid_near) {
+            float ndc[4] = { INFINITY, -INFINITY, INFINITY, -INFINITY };
+            for (float depth : { closest, farthest }) {
+                for (float x : { center.x - radius, center.x + radius }) {
+                    float px = grid_projection[0][0] * x / depth;
+                    ndc[0] = std::min(ndc[0], px);
+                    ndc[1] = std::max(ndc[1], px);
+                }
+                for (float y : { center.y - radius, center.y + radius }) {
+                    float py = grid_projection[1][1] * y / depth;
+                    ndc[2] = std::min(ndc[2], py);
+                    ndc[3] = std::max(ndc[3], py);
+                }
+            }
+            if (ndc[0] > 1.0f || ndc[1] < -1.0f || ndc[2] > 1.0f || ndc[3] < -1.0f)
+                return;
+
+            min_x = std::clamp((int)std::floor((ndc[0] * 0.5f + 0.5f) * CLUSTER_X), 0, (int)CLUSTER_X - 1);
+            max_x = std::clamp((int)std::floor((ndc[1] * 0.5f + 0.5f) * CLUSTER_X), 0, (int)CLUSTER_X - 1);
+            min_y = std::clamp((int)std::floor((ndc[2] * 0.5f + 0.5f) * CLUSTER_Y), 0, (int)CLUSTER_Y - 1);
+            max_y = std::clamp((int)std::floor((ndc[3] * 0.5f + 0.5f) * CLUSTER_Y), 0, (int)CLUSTER_Y - 1);
+        }
+
+        bounds.min = glm::ivec3(min_x, min_y, sliceOf(std::max(closest, grid_near)));
+        bounds.max = glm::ivec3(max_x, max_y, sliceOf(std::min(farthest, grid_far)));
+    }
+
+    static bool sphereTouches(const AABB &box, const glm::vec3 &center, float radius_squared)
+    {
+        glm::vec3 offset = glm::clamp(center, box.min, box.max) - center;
+        return glm::dot(offset, offset) <= radius_squared;
+    }
+
+    void assignRow(unsigned int y, unsigned int z, std::vector<uint8_t> &touched)
+    {
+        const AABB &row = row_bounds[y + CLUSTER_Y * z];
+        for (uint32_t light : slice_lights[z]) {
+            const LightBounds &bounds = light_bounds[light];
+            if ((int)y < bounds.min.y || (int)y > bounds.max.y)
+                continue;
+
+            // The screen rect is loose for lights close to the camera, most rows get rejected here
+            float radius_squared = bounds.radius * bounds.radius;
+            if (!sphereTouches(row, bounds.center, radius_squared))
+                continue;
+
+            for (int x = bounds.min.x; x <= bounds.max.x; ++x) {
+                unsigned int cluster = x + CLUSTER_X * (y + CLUSTER_Y * z);
+                if (!sphereTouches(cluster_bounds[cluster], bounds.center, radius_squared))
+                    continue;
+
+                uint32_t slot = cluster_counts[cluster]++;
+                if (slot < MAX_LIGHTS_PER_CLUSTER)
+                    cluster_lights[(size_t)cluster * MAX_LIGHTS_PER_CLUSTER + slot] = light;
+                // Several rows can flag the same light
+                std::atomic_ref<uint8_t>(touched[light]).store(1, std::memory_order_relaxed);
+            }
+        }
+    }
+};
@@ -0,0 +1,410 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Utils/resource_manager.hpp>
+#include <Utils/shader.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+/// Debug drawing
+///
+/// Immediate mode lines and triangles for looking at culling, physics and the
+/// like. Call the shapes from anywhere on the main thread during the frame, then
+/// Draw() once after the scene. Nothing is kept between frames.
+///
+/// Vertices are written straight into a persistently mapped, coherent buffer
+/// split into DEBUG_DRAW_FRAMES regions. Each region gets a fence when it's
+/// drawn and is only written again once the GPU is past that fence, so the CPU
+/// never stalls on a buffer the GPU still reads unless it's frames ahead.
+/// A full region drops whatever doesn't fit (see Stats.dropped).
+///
+/// There is one draw per primitive type and depth mode (lines / triangles,
+/// depth tested / overlay), shapes of the same kind are merged into
+/// glMultiDrawArrays runs.
+///
+/// Only built with GREYHEAVENS_DEBUG_DRAW (on for Debug builds), otherwise
+/// DebugDraw is an empty class and every call compiles to nothing.
+
+// RGBA8, R in the low byte (same as the particles)
+const uint32_t DEBUG_WHITE = 0xFFFFFFFF;
+const uint32_t DEBUG_RED = 0xFF0000FF;
+const uint32_t DEBUG_GREEN = 0xFF00FF00;
+const uint32_t DEBUG_BLUE = 0xFFFF0000;
+const uint32_t DEBUG_YELLOW = 0xFF00FFFF;
+const uint32_t DEBUG_CYAN = 0xFFFFFF00;
+const uint32_t DEBUG_MAGENTA = 0xFFFF00FF;
+
+inline uint32_t DebugColor(float r, float g, float b, float a = 1.0f)
+{
+    auto channel = [](float value) { return (uint32_t)(glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+    return channel(r) | (channel(g) << 8) | (channel(b) << 16) | (channel(a) << 24);
+}
+
+enum Debug_Depth {
+    DEBUG_DEPTH_TEST,   // hidden behind the scene like everything else
+    DEBUG_OVERLAY       // always on top
+};
+
+// Mirrors the attributes of debug.vert
+struct DebugVertex {
+    glm::vec3 position;
+    uint32_t color;
+};
+
+struct DebugDrawStats {
+    size_t vertices = 0;  // last frame
+    size_t dropped = 0;   // last frame, didn't fit in the region
+    unsigned int draws = 0;
+    double wait_ms = 0.0; // on the fence of the region we're about to write
+};
+
+const int DEBUG_DRAW_FRAMES = 3;
+const size_t DEBUG_DRAW_FRAME_BYTES = 8 * 1024 * 1024; // ~20k boxes
+
+#ifdef GREYHEAVENS_DEBUG_DRAW
+
+class DebugDraw
+{
+public:
+    DebugDrawStats Stats;
+
+    // gl = false keeps the vertices in plain memory and never draws, for headless runs
+    void Init(size_t frame_bytes = DEBUG_DRAW_FRAME_BYTES, bool gl = true)
+    {
+        this->gl = gl;
+        region_vertices = frame_bytes / sizeof(DebugVertex);
+        size_t bytes = region_vertices * sizeof(DebugVertex) * DEBUG_DRAW_FRAMES;
+
+        if (!gl) {
+            memory.resize(region_vertices * DEBUG_DRAW_FRAMES);
+            mapped = memory.data();
+            return;
+        }
+
+        shader = Shader("shaders/basic/debug.vert", "shaders/basic/debug.frag");
+        ResourceManager &resources = GetResourceManager();
+        program = resources.AdoptProgram(shader.ID);
+        VAO = resources.CreateVertexArray();
+        VBO = resources.CreateBuffer(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBindVertexArray(resources.Get(VAO));
+        resources.BufferStorage(VBO, GL_ARRAY_BUFFER, (GLsizeiptr)bytes, nullptr, flags);
+        mapped = (DebugVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr)bytes, flags);
+        if (!mapped)
+            std::cout << "ERROR::DEBUG_DRAW::MAP_FAILED" << std::endl;
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(DebugVertex), (void*)offsetof(DebugVertex, color));
+        glEnableVertexAttribArray(1);
+        glBindVertexArray(0);
+    }
+
+    void Line(const glm::vec3 &a, const glm::vec3 &b, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST)
+    {
+        DebugVertex* out = append(LINES, depth, 2);
+        if (!out)
+            return;
+        out[0] = { a, color };
+        out[1] = { b, color };
+    }
+
+    void Triangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST)
+    {
+        DebugVertex* out = append(TRIANGLES, depth, 3);
+        if (!out)
+            return;
+        out[0] = { a, color };
+        out[1] = { b, color };
+        out[2] = { c, color };
+    }
+
+    // Axis aligned
+    void Box(const glm::vec3 &min, const glm::vec3 &max, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST)
+    {
+        glm::vec3 corners[8];
+        for (int i = 0; i < 8; ++i)
+            corners[i] = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+        edges(corners, color, depth);
+    }
+
+    // Oriented, the unit cube of Primitives (-0.5 to 0.5) through transform
+    void Box(const glm::mat4 &transform, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST)
+    {
+        glm::vec3 corners[8];
+        for (int i = 0; i < 8; ++i)
+            corners[i] = glm::vec3(transform * glm::vec4(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f, 1.0f));
+        edges(corners, color, depth);
+    }
+
+    // Three great circles
+    void Sphere(const glm::vec3 &center, float radius, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST)
+    {
+        DebugVertex* out = append(LINES, depth, SPHERE_SEGMENTS * 6);
+        if (!out)
+            return;
+        const glm::vec2* circle = unitCircle();
+        for (int i = 0; i < SPHERE_SEGMENTS; ++i) {
+            glm::vec2 a = circle[i] * radius;
+            glm::vec2 b = circle[(i + 1) % SPHERE_SEGMENTS] * radius;
+            *out++ = { center + glm::vec3(a.x, a.y, 0.0f), color };
+            *out++ = { center + glm::vec3(b.x, b.y, 0.0f), color };
+            *out++ = { center + glm::vec3(a.x, 0.0f, a.y), color };
+            *out++ = { center + glm::vec3(b.x, 0.0f, b.y), color };
+            *out++ = { center + glm::vec3(0.0f, a.x, a.y), color };
+            *out++ = { center + glm::vec3(0.0f, b.x, b.y), color };
+        }
+    }
+
+    // The volume a projection * view matrix sees, corners are the NDC box between near_depth and
+    // far_depth pulled back to world space. The defaults are GL's -1 to 1, SceneTarget's reversed-Z
+    // projection needs 1 and 0. Its far plane is at infinity, far corners stop at max_distance.
+    void Frustum(const glm::mat4 &view_projection, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST,
+        float near_depth = -1.0f, float far_depth = 1.0f, float max_distance = 100.0f)
+    {
+        glm::mat4 inverse = glm::inverse(view_projection);
+        glm::vec3 corners[8];
+        for (int i = 0; i < 4; ++i) {
+            glm::vec2 ndc(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f);
+            glm::vec4 near_corner = inverse * glm::vec4(ndc.x, ndc.y, near_depth, 1.0f);
+            glm::vec4 far_corner = inverse * glm::vec4(ndc.x, ndc.y, far_depth, 1.0f);
+            corners[i] = glm::vec3(near_corner) / near_corner.w;
+
+            // (far - near) * w, still a direction when w reaches 0 at an infinite far plane
+            glm::vec3 ray = glm::vec3(far_corner) - corners[i] * far_corner.w;
+            float length = glm::length(ray);
+            float distance = std::abs(far_corner.w) * max_distance < length ? max_distance : length / std::abs(far_corner.w);
+            corners[i + 4] = corners[i] + (far_corner.w < 0.0f ? -ray : ray) / length * distance;
+        }
+        edges(corners, color, depth);
+    }
+
+    // X red, Y green, Z blue, along the transform's axes
+    void Axes(const glm::mat4 &transform, float size = 1.0f, Debug_Depth depth = DEBUG_OVERLAY)
+    {
+        glm::vec3 origin = glm::vec3(transform[3]);
+        Line(origin, origin + glm::vec3(transform[0]) * size, DEBUG_RED, depth);
+        Line(origin, origin + glm::vec3(transform[1]) * size, DEBUG_GREEN, depth);
+        Line(origin, origin + glm::vec3(transform[2]) * size, DEBUG_BLUE, depth);
+    }
+
+    // Once per frame after the scene, then moves on to the next region.
+    // Depth testing uses whatever depth func is current. Depth test, depth
+    // mask and blending are back to how the caller had them afterwards,
+    // the blend func is left at alpha blending.
+    void Draw(const glm::mat4 &view, const glm::mat4 &projection)
+    {
+        Stats.vertices = cursor;
+        Stats.dropped = dropped;
+        Stats.draws = 0;
+
+        if (gl && mapped && cursor > 0) {
+            ResourceManager &resources = GetResourceManager();
+            shader.use();
+            shader.setMat4("view_projection", projection * view);
+            glBindVertexArray(resources.Get(VAO));
+
+            GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+            GLboolean blend = glIsEnabled(GL_BLEND);
+            GLboolean depth_mask = GL_TRUE;
+            glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask);
+
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+
+            for (int batch = 0; batch < BATCH_COUNT; ++batch) {
+                Batch &runs = batches[batch];
+                if (runs.firsts.empty())
+                    continue;
+                if (batch & OVERLAY_BIT)
+                    glDisable(GL_DEPTH_TEST);
+                else
+                    glEnable(GL_DEPTH_TEST);
+                GLenum mode = (batch & TRIANGLES) ? GL_TRIANGLES : GL_LINES;
+                glMultiDrawArrays(mode, runs.firsts.data(), runs.counts.data(), (GLsizei)runs.firsts.size());
+                ++Stats.draws;
+            }
+
+            if (depth_test)
+                glEnable(GL_DEPTH_TEST);
+            else
+                glDisable(GL_DEPTH_TEST);
+            if (!blend)
+                glDisable(GL_BLEND);
+            glDepthMask(depth_mask);
+            glBindVertexArray(0);
+        }
+
+        if (gl && cursor > 0)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        nextRegion();
+    }
+
+    void Release()
+    {
+        if (gl) {
+            for (GLsync &fence : fences) {
+                if (fence)
+                    glDeleteSync(fence);
+                fence = nullptr;
+            }
+            ResourceManager &resources = GetResourceManager();
+            if (mapped) {
+                glBindBuffer(GL_ARRAY_BUFFER, resources.Get(VBO));
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            }
+            resources.Release(VAO);
+            resources.Release(VBO);
+            resources.Release(program);
+            VAO = VBO = program = ResourceHandle();
+        }
+        memory.clear();
+        mapped = nullptr;
+    }
+
+private:
+    // Bit 0 is the primitive, bit 1 the depth mode
+    enum Batch_Kind {
+        LINES = 0,
+        TRIANGLES = 1,
+        OVERLAY_BIT = 2,
+        BATCH_COUNT = 4
+    };
+
+    struct Batch {
+        std::vector<GLint> firsts;
+        std::vector<GLsizei> counts;
+    };
+
+    static constexpr int SPHERE_SEGMENTS = 32;
+
+    bool gl = true;
+    Shader shader;
+    ResourceHandle program;
+    ResourceHandle VAO;
+    ResourceHandle VBO;
+    DebugVertex* mapped = nullptr;
+    std::vector<DebugVertex> memory; // headless only
+    GLsync fences[DEBUG_DRAW_FRAMES] = {};
+    size_t region_vertices = 0;
+    int region = 0;
+    size_t cursor = 0;  // vertices written into the current region
+    size_t dropped = 0;
+    Batch batches[BATCH_COUNT];
+
+    // Room for count vertices of one batch, nullptr once the region is full
+    DebugVertex* append(Batch_Kind primitive, Debug_Depth depth, size_t count)
+    {
+        if (!mapped || cursor + count > region_vertices) {
+            dropped += count;
+            return nullptr;
+        }
+
+        // Same batch as the last shape, keep growing its run
+        Batch &runs = batches[primitive | (depth == DEBUG_OVERLAY ? OVERLAY_BIT : 0)];
+        GLint first = (GLint)(region * region_vertices + cursor);
+        if (!runs.firsts.empty() && runs.firsts.back() + runs.counts.back() == first) {
+            runs.counts.back() += (GLsizei)count;
+        } else {
+            runs.firsts.push_back(first);
+            runs.counts.push_back((GLsizei)count);
+        }
+
+        DebugVertex* out = mapped + region * region_vertices + cursor;
+        cursor += count;
+        return out;
+    }
+
+    void edges(const glm::vec3 corners[8], uint32_t color, Debug_Depth depth)
+    {
+        // Corner index bits are x, y, z
+        static const int EDGES[24] = {
+            0, 1, 2, 3, 4, 5, 6, 7, // along x
+            0, 2, 1, 3, 4, 6, 5, 7, // along y
+            0, 4, 1, 5, 2, 6, 3, 7  // along z
+        };
+        DebugVertex* out = append(LINES, depth, 24);
+        if (!out)
+            return;
+        for (int i = 0; i < 24; ++i)
+            out[i] = { corners[EDGES[i]], color };
+    }
+
+    static const glm::vec2* unitCircle()
+    {
+        static const std::vector<glm::vec2> circle = [] {
+            std::vector<glm::vec2> points(SPHERE_SEGMENTS);
+            for (int i = 0; i < SPHERE_SEGMENTS; ++i) {
+                float angle = 6.28318530718f * (float)i / (float)SPHERE_SEGMENTS;
+                points[i] = glm::vec2(std::cos(angle), std::sin(angle));
+            }
+            return points;
+        }();
+        return circle.data();
+    }
+
+    void nextRegion()
+    {
+        for (Batch &runs : batches) {
+            runs.firsts.clear();
+            runs.counts.clear();
+        }
+        region = (region + 1) % DEBUG_DRAW_FRAMES;
+        cursor = 0;
+        dropped = 0;
+
+        // The GPU may still be reading this region from DEBUG_DRAW_FRAMES frames ago
+        Stats.wait_ms = 0.0;
+        GLsync &fence = fences[region];
+        if (!fence)
+            return;
+        auto start = std::chrono::steady_clock::now();
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(fence, 0, 1000000); // 1 ms
+        if (result == GL_WAIT_FAILED)
+            std::cout << "ERROR::DEBUG_DRAW::FENCE_WAIT_FAILED" << std::endl;
+        glDeleteSync(fence);
+        fence = nullptr;
+        Stats.wait_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+#else
+
+// Release builds: same interface, nothing in it
+class DebugDraw
+{
+public:
+    DebugDrawStats Stats;
+
+    void Init(size_t frame_bytes = DEBUG_DRAW_FRAME_BYTES, bool gl = true) {}
+    void Line(const glm::vec3 &a, const glm::vec3 &b, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST) {}
+    void Triangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST) {}
+    void Box(const glm::vec3 &min, const glm::vec3 &max, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST) {}
+    void Box(const glm::mat4 &transform, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST) {}
+    void Sphere(const glm::vec3 &center, float radius, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST) {}
+    void Frustum(const glm::mat4 &view_projection, uint32_t color, Debug_Depth depth = DEBUG_DEPTH_TEST,
+        float near_depth = -1.0f, float far_depth = 1.0f, float max_distance = 100.0f) {}
+    void Axes(const glm::mat4 &transform, float size = 1.0f, Debug_Depth depth = DEBUG_OVERLAY) {}
+    void Draw(const glm::mat4 &view, const glm::mat4 &projection) {}
+    void Release() {}
+};
+
+#endif
+
+// The one debug drawer everything shares, so culling or physics code can draw without plumbing
+inline DebugDraw& GetDebugDraw()
+{
+    static DebugDraw debug_draw;
+    return debug_draw;
+}
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Utils/render_stats.hpp>
+#include <Utils/resource_manager.hpp>
+#include <Utils/shader.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/// Performance HUD
+///
+/// Render stats and a frame time graph in the top left corner, drawn over the
+/// finished frame (after RenderStats::EndFrame(), so it never counts itself).
+///
+/// Everything is a screen space quad, one instanced draw for the whole HUD.
+/// Text uses a built in 5x7 bitmap font (ASCII 32 to 95, lower case is shown
+/// as upper case). Glyph bits go to hud.frag as a uniform array, no texture.
+
+// One quad, mirrors the instanced attributes of hud.vert
+struct HudQuad {
+    float x, y, width, height; // pixels, origin top left
+    uint32_t glyph;            // HUD_SOLID for a plain rectangle
+    uint32_t color;            // RGBA8, R in the low byte
+};
+
+const uint32_t HUD_SOLID = 0xFFFFFFFF;
+const int HUD_GLYPH_WIDTH = 5;
+const int HUD_GLYPH_HEIGHT = 7;
+const int HUD_FIRST_GLYPH = 32;
+const int HUD_GLYPH_COUNT = 64;
+
+// Row major, bit (row * 5 + column), row 0 on top
+const uint64_t HUD_FONT[HUD_GLYPH_COUNT] = {
+    0x000000000ull, 0x100421084ull, 0x00000014Aull, 0x295F57D4Aull,
+    0x11F4717C4ull, 0x632222263ull, 0x593511526ull, 0x000000084ull,
+    0x208210888ull, 0x088842082ull, 0x009575480ull, 0x0084F9080ull,
+    0x088C00000ull, 0x0000F8000ull, 0x18C000000ull, 0x002222200ull,
+    0x3A33AE62Eull, 0x3884210C4ull, 0x7C444422Eull, 0x3A304111Full,
+    0x211F4A988ull, 0x3A3083C3Full, 0x3A317844Cull, 0x08422221Full,
+    0x3A317462Eull, 0x1910F462Eull, 0x00C6018C0ull, 0x0886018C0ull,
+    0x208208888ull, 0x001F07C00ull, 0x088882082ull, 0x10044422Eull,
+    0x3AB5B422Eull, 0x4631FC62Eull, 0x3E317C62Full, 0x3A210862Eull,
+    0x1D318C527ull, 0x7C217843Full, 0x04217843Full, 0x7A31E862Eull,
+    0x4631FC631ull, 0x38842108Eull, 0x19284211Cull, 0x452519531ull,
+    0x7C2108421ull, 0x4631AD771ull, 0x4639ACE31ull, 0x3A318C62Eull,
+    0x04217C62Full, 0x59358C62Eull, 0x45257C62Full, 0x3E107043Eull,
+    0x10842109Full, 0x3A318C631ull, 0x11518C631ull, 0x2AB5AC631ull,
+    0x462A22A31ull, 0x108422A31ull, 0x7C222221Full, 0x38421084Eull,
+    0x020820820ull, 0x39084210Eull, 0x000004544ull, 0x7C0000000ull,
+};
+
+class Hud
+{
+public:
+    int Scale = 2;                 // screen pixels per font pixel
+    float GraphCeilingMs = 50.0f;  // top of the frame time graph
+
+    void Init()
+    {
+        shader = Shader("shaders/basic/hud.vert", "shaders/basic/hud.frag");
+        ResourceManager &resources = GetResourceManager();
+        program = resources.AdoptProgram(shader.ID);
+        VAO = resources.CreateVertexArray();
+        VBO = resources.CreateBuffer(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+
+        glBindVertexArray(resources.Get(VAO));
+        glBindBuffer(GL_ARRAY_BUFFER, resources.Get(VBO));
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(HudQuad), (void*)offsetof(HudQuad, x));
+        glEnableVertexAttribArray(0);
+        glVertexAttribDivisor(0, 1);
+        glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(HudQuad), (void*)offsetof(HudQuad, glyph));
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudQuad), (void*)offsetof(HudQuad, color));
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        glBindVertexArray(0);
+
+        // Low and high word of every glyph
+        uint32_t words[HUD_GLYPH_COUNT * 2];
+        for (int i = 0; i < HUD_GLYPH_COUNT; ++i) {
+            words[i * 2] = (uint32_t)HUD_FONT[i];
+            words[i * 2 + 1] = (uint32_t)(HUD_FONT[i] >> 32);
+        }
+        shader.use();
+        shader.setUintArray("font", words, HUD_GLYPH_COUNT * 2);
+    }
+
+    // Over whatever framebuffer is bound, expects the window size
+    void Draw(const RenderStats &stats, int width, int height)
+    {
+        quads.clear();
+        const RenderCounters &counters = stats.Last;
+        const FrameTiming &timing = stats.Timing;
+        const PipelineCounters &pipeline = stats.Pipeline;
+        char line[160];
+
+        std::vector<std::string> lines;
+        snprintf(line, sizeof(line), "FRAME %.2f MS  CPU %.2f MS  GPU %.2f MS  %.0f FPS",
+            timing.frame_ms, timing.cpu_ms, timing.gpu_ms, timing.frame_ms > 0.0 ? 1000.0 / timing.frame_ms : 0.0);
+        lines.push_back(line);
+        snprintf(line, sizeof(line), "DRAWS %s  INSTANCES %s  TRIANGLES %s",
+            compact(counters.draw_calls).c_str(), compact(counters.instances).c_str(), compact(counters.triangles).c_str());
+        lines.push_back(line);
+        snprintf(line, sizeof(line), "BINDS  PROGRAM %s  VAO %s  TEXTURE %s  BUFFER %s  FBO %s",
+            compact(counters.program_binds).c_str(), compact(counters.vao_binds).c_str(), compact(counters.texture_binds).c_str(),
+            compact(counters.buffer_binds).c_str(), compact(counters.framebuffer_binds).c_str());
+        lines.push_back(line);
+        snprintf(line, sizeof(line), "STATE %s  UNIFORMS %s  UPLOADS %s (%.2f MB)  TEXTURE UPLOADS %s",
+            compact(counters.state_changes).c_str(), compact(counters.uniform_uploads).c_str(), compact(counters.buffer_uploads).c_str(),
+            counters.upload_bytes / (1024.0 * 1024.0), compact(counters.texture_uploads).c_str());
+        lines.push_back(line);
+        if (pipeline.valid) {
+            snprintf(line, sizeof(line), "GPU  VERTICES %s  VS %s  PRIMITIVES %s  CLIPPED %s  FS %s",
+                compact(pipeline.vertices_submitted).c_str(), compact(pipeline.vertex_shader_invocations).c_str(),
+                compact(pipeline.clipping_input_primitives).c_str(), compact(pipeline.clipping_output_primitives).c_str(),
+                compact(pipeline.fragment_shader_invocations).c_str());
+            lines.push_back(line);
+        } else if (!stats.PipelineSupported) {
+            lines.push_back("GPU  NO PIPELINE STATISTICS");
+        }
+
+        const float margin = 8.0f;
+        const float padding = 6.0f;
+        float advance = (float)((HUD_GLYPH_WIDTH + 1) * Scale);
+        float line_height = (float)((HUD_GLYPH_HEIGHT + 3) * Scale);
+        float bar_width = (float)Scale;
+        float graph_width = bar_width * RENDER_STATS_HISTORY;
+        float graph_height = 40.0f * Scale;
+
+        size_t longest = 0;
+        for (const std::string &text : lines)
+            longest = std::max(longest, text.size());
+        float panel_width = std::max(longest * advance, graph_width) + padding * 2.0f;
+        float panel_height = lines.size() * line_height + graph_height + padding * 3.0f;
+        rect(margin, margin, panel_width, panel_height, 0xB0000000);
+
+        float x = margin + padding;
+        float y = margin + padding;
+        for (const std::string &text : lines) {
+            this->text(x, y, text, 0xFFFFFFFF);
+            y += line_height;
+        }
+
+        // Frame time graph, oldest on the left, green within 60 fps, yellow within 30
+        float graph_top = y + padding;
+        float graph_bottom = graph_top + graph_height;
+        rect(x, graph_top, graph_width, graph_height, 0x60303030);
+        for (int age = 0; age < RENDER_STATS_HISTORY; ++age) {
+            float ms = stats.FrameTime(age);
+            if (ms <= 0.0f)
+                continue;
+            float bar = std::min(ms / GraphCeilingMs, 1.0f) * graph_height;
+            uint32_t color = ms <= 16.7f ? 0xFF40D040 : (ms <= 33.4f ? 0xFF30D0E0 : 0xFF3030E0);
+            rect(x + (RENDER_STATS_HISTORY - 1 - age) * bar_width, graph_bottom - bar, bar_width, bar, color);
+        }
+        for (float budget : { 16.7f, 33.3f }) {
+            if (budget < GraphCeilingMs)
+                rect(x, graph_bottom - budget / GraphCeilingMs * graph_height, graph_width, 1.0f, 0x80FFFFFF);
+        }
+
+        ResourceManager &resources = GetResourceManager();
+        resources.BufferData(VBO, GL_ARRAY_BUFFER, quads.size() * sizeof(HudQuad), quads.data(), GL_STREAM_DRAW);
+
+        glViewport(0, 0, width, height);
+        glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        shader.use();
+        shader.setVec2("screen_size", (float)width, (float)height);
+        glBindVertexArray(resources.Get(VAO));
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)quads.size());
+
+        glDisable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        glBindVertexArray(0);
+    }
+
+    void Release()
+    {
+        ResourceManager &resources = GetResourceManager();
+        resources.Release(VAO);
+        resources.Release(VBO);
+        resources.Release(program);
+        VAO = VBO = program = ResourceHandle();
+    }
+
+private:
+    Shader shader;
+    ResourceHandle program;
+    ResourceHandle VAO;
+    ResourceHandle VBO;
+    std::vector<HudQuad> quads;
+
+    void rect(float x, float y, float width, float height, uint32_t color)
+    {
+        quads.push_back({ x, y, width, height, HUD_SOLID, color });
+    }
+
+    void text(float x, float y, const std::string &text, uint32_t color)
+    {
+        float advance = (float)((HUD_GLYPH_WIDTH + 1) * Scale);
+        for (char c : text) {
+            if (c >= 'a' && c <= 'z')
+                c = (char)(c - 'a' + 'A');
+            int glyph = (int)(unsigned char)c - HUD_FIRST_GLYPH;
+            if (glyph < 0 || glyph >= HUD_GLYPH_COUNT)
+                glyph = '?' - HUD_FIRST_GLYPH;
+            if (glyph != 0) // space
+                quads.push_back({ x, y, (float)(HUD_GLYPH_WIDTH * Scale), (float)(HUD_GLYPH_HEIGHT * Scale), (uint32_t)glyph, color });
+            x += advance;
+        }
+    }
+
+    // 999, 12.3K, 4.56M
+    static std::string compact(uint64_t value)
+    {
+        char text[32];
+        if (value >= 10000000)
+            snprintf(text, sizeof(text), "%.1fM", value / 1e6);
+        else if (value >= 1000000)
+            snprintf(text, sizeof(text), "%.2fM", value / 1e6);
+        else if (value >= 10000)
+            snprintf(text, sizeof(text), "%.1fK", value / 1e3);
+        else
+            snprintf(text, sizeof(text), "%llu", (unsigned long long)value);
+        return text;
+    }
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Utils/vfs.hpp>
+
+#include <string>
+
+// Only one translation unit defines STB_IMAGE_IMPLEMENTATION and includes
+// stb_image.h itself, including it again here would define everything twice
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include <stb_image.h>
+#endif
+
+/// Image decoding through the mounted VFS, same results as stbi_load on the
+/// loose file. Free with stbi_image_free.
+inline unsigned char* LoadImageFile(const std::string &path, int *width, int *height, int *nrComponents, int desired_components)
+{
+    VFS::AssetData file = GetFileSystem().Read(path);
+    if (!file.IsValid())
+        return nullptr;
+    return stbi_load_from_memory(file.Data(), (int)file.Size(), width, height, nrComponents, desired_components);
+}
+
+// Header only, no decode
+inline bool ImageInfo(const std::string &path, int *width, int *height, int *nrComponents)
+{
+    VFS::AssetData file = GetFileSystem().Read(path);
+    return file.IsValid() && stbi_info_from_memory(file.Data(), (int)file.Size(), width, height, nrComponents);
+}
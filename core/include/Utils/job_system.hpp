@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Job system
+///
+/// A fixed pool of worker threads with one FIFO queue.
+/// - Submit(): fire and forget, e.g. streaming loads.
+/// - ParallelFor(): splits [0, count) into batches and blocks until all are
+///   done. The calling thread works on batches too, so it finishes even when
+///   every worker is stuck in a long Submit() job.
+class JobSystem
+{
+public:
+    // 0 picks one worker per hardware thread, minus the one calling ParallelFor
+    JobSystem(unsigned int worker_count = 0)
+    {
+        if (worker_count == 0) {
+            unsigned int hardware = std::thread::hardware_concurrency();
+            worker_count = hardware > 1 ? hardware - 1 : 1;
+        }
+        for (unsigned int i = 0; i < worker_count; ++i)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem& operator=(const JobSystem &) = delete;
+
+    unsigned int WorkerCount() const
+    {
+        return (unsigned int)workers.size();
+    }
+
+    void Submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(job));
+        }
+        wake.notify_one();
+    }
+
+    // fn(begin, end) for batches of at least min_batch items, blocks until done.
+    // max_threads limits how many threads (caller included) take part, 0 is all.
+    void ParallelFor(size_t count, size_t min_batch, const std::function<void(size_t begin, size_t end)> &fn, unsigned int max_threads = 0)
+    {
+        if (count == 0)
+            return;
+
+        size_t threads = workers.size() + 1;
+        if (max_threads > 0)
+            threads = std::min<size_t>(threads, max_threads);
+        size_t batches = std::min(threads * 4, (count + min_batch - 1) / std::max<size_t>(min_batch, 1));
+        if (batches <= 1) {
+            fn(0, count);
+            return;
+        }
+
+        // Shared with the helpers, a helper that starts late finds nothing left and leaves
+        struct Batches {
+            std::atomic<size_t> next { 0 };
+            std::atomic<size_t> done { 0 };
+            size_t count;
+            size_t batch_count;
+            const std::function<void(size_t, size_t)>* fn;
+            std::mutex mutex;
+            std::condition_variable finished;
+
+            bool runOne()
+            {
+                size_t batch = next.fetch_add(1);
+                if (batch >= batch_count)
+                    return false;
+                size_t begin = count * batch / batch_count;
+                size_t end = count * (batch + 1) / batch_count;
+                (*fn)(begin, end);
+                if (done.fetch_add(1) + 1 == batch_count) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished.notify_all();
+                }
+                return true;
+            }
+        };
+
+        auto state = std::make_shared<Batches>();
+        state->count = count;
+        state->batch_count = batches;
+        state->fn = &fn;
+
+        size_t helpers = std::min(threads - 1, batches - 1);
+        for (size_t i = 0; i < helpers; ++i) {
+            Submit([state] {
+                while (state->runOne()) {}
+            });
+        }
+
+        while (state->runOne()) {}
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&] { return state->done.load() == state->batch_count; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping && queue.empty())
+                    return;
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            job();
+        }
+    }
+};
+
+inline JobSystem& GetJobSystem()
+{
+    static JobSystem job_system;
+    return job_system;
+}
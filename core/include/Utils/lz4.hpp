@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/// LZ4 block format, just enough for asset packs
+///
+/// Compress() is a plain greedy matcher (single hash probe), the pack tool is
+/// the only user so ratio beats speed there. Decompress() is the hot one and
+/// checks every length against both buffers, a corrupt pack must not take the
+/// game down with it.
+///
+/// Format reference: https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+namespace LZ4 {
+
+const int MIN_MATCH     = 4;
+const int LAST_LITERALS = 5;  // the last 5 bytes are always literals
+const int MF_LIMIT      = 12; // no match may start within the last 12 bytes
+const int HASH_BITS     = 16;
+const int MAX_OFFSET    = 65535;
+
+inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+inline uint32_t hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+inline void writeLength(std::vector<uint8_t> &out, size_t length)
+{
+    while (length >= 255) {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back((uint8_t)length);
+}
+
+inline void writeSequence(std::vector<uint8_t> &out, const uint8_t* literals, size_t literal_length, size_t offset, size_t match_length)
+{
+    size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+    uint8_t token = (uint8_t)((literal_length < 15 ? literal_length : 15) << 4);
+    if (match_length)
+        token |= (uint8_t)(match_code < 15 ? match_code : 15);
+    out.push_back(token);
+
+    if (literal_length >= 15)
+        writeLength(out, literal_length - 15);
+    out.insert(out.end(), literals, literals + literal_length);
+
+    if (!match_length)
+        return;
+    out.push_back((uint8_t)(offset & 0xFF));
+    out.push_back((uint8_t)(offset >> 8));
+    if (match_code >= 15)
+        writeLength(out, match_code - 15);
+}
+
+// Appends the compressed block to out
+inline void Compress(const uint8_t* src, size_t size, std::vector<uint8_t> &out)
+{
+    size_t anchor = 0;
+
+    if (size > (size_t)MF_LIMIT) {
+        std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0xFFFFFFFFu);
+        size_t match_limit = size - LAST_LITERALS;
+        size_t position = 0;
+
+        while (position + MF_LIMIT <= size) {
+            uint32_t sequence = read32(src + position);
+            uint32_t &slot = table[hash(sequence)];
+            size_t candidate = slot;
+            slot = (uint32_t)position;
+
+            if (candidate == 0xFFFFFFFFu || position - candidate > (size_t)MAX_OFFSET || read32(src + candidate) != sequence) {
+                ++position;
+                continue;
+            }
+
+            size_t length = MIN_MATCH;
+            while (position + length < match_limit && src[candidate + length] == src[position + length])
+                ++length;
+
+            writeSequence(out, src + anchor, position - anchor, position - candidate, length);
+            position += length;
+            anchor = position;
+        }
+    }
+
+    // Trailing literals
+    writeSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+// Decompresses exactly dst_size bytes, false on malformed input
+inline bool Decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size)
+{
+    const uint8_t* ip = src;
+    const uint8_t* const ip_end = src + src_size;
+    uint8_t* op = dst;
+    uint8_t* const op_end = dst + dst_size;
+
+    while (ip < ip_end) {
+        uint8_t token = *ip++;
+
+        // Literals
+        size_t literal_length = token >> 4;
+        if (literal_length == 15) {
+            uint8_t extra;
+            do {
+                if (ip >= ip_end)
+                    return false;
+                extra = *ip++;
+                literal_length += extra;
+            } while (extra == 255);
+        }
+        if ((size_t)(ip_end - ip) < literal_length || (size_t)(op_end - op) < literal_length)
+            return false;
+        memcpy(op, ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        // The last sequence has no match
+        if (ip == ip_end)
+            break;
+
+        // Match
+        if (ip_end - ip < 2)
+            return false;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst))
+            return false;
+
+        size_t match_length = (token & 0x0F);
+        if (match_length == 15) {
+            uint8_t extra;
+            do {
+                if (ip >= ip_end)
+                    return false;
+                extra = *ip++;
+                match_length += extra;
+            } while (extra == 255);
+        }
+        match_length += MIN_MATCH;
+        if ((size_t)(op_end - op) < match_length)
+            return false;
+
+        // Overlapping matches repeat their own output, those go byte by byte
+        const uint8_t* match = op - offset;
+        if (offset >= match_length) {
+            memcpy(op, match, match_length);
+        }
+        else {
+            for (size_t i = 0; i < match_length; ++i)
+                op[i] = match[i];
+        }
+        op += match_length;
+    }
+
+    return op == op_end;
+}
+
+}
@@ -0,0 +1,818 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+/// Mesh LOD
+///
+/// Simplification is quadric error edge collapse (Garland & Heckbert). Every
+/// vertex carries the planes of the triangles around it, a collapse moves a
+/// vertex onto one of its neighbours and the merged planes tell how far that
+/// strays from the original surface. Collapses run in passes, cheapest first,
+/// each pass touching a vertex neighbourhood at most once, until nothing is
+/// left under the target error.
+///
+/// Vertices only ever move onto other vertices, so every level indexes the
+/// same vertex buffer: a LOD chain is one vertex buffer plus the index lists
+/// of every level back to back.
+///
+/// What is kept:
+/// - UV seams, vertices sharing a position with different attributes, never move
+/// - border vertices (on an open edge) only slide along the border, or never
+///   move with LOD_LOCK_BORDER, which is what tiles like the ground chunks need
+///   so neighbours at different levels still meet without cracks
+/// - collapses that would flip a triangle or pinch the mesh are skipped
+///
+/// Targets are RMS quadric distances, that is what decides which collapses
+/// are cheap. The worst spot of a level tends to be two to three times its
+/// target, so the error stored per level is measured after the fact: the
+/// largest distance from any full detail vertex to the level's surface, in
+/// mesh units. LodSelector projects that to pixels and picks a level per object.
+
+struct LodLevel {
+    uint32_t index_offset = 0; // into the chain's indices
+    uint32_t index_count = 0;
+    float error = 0.0f;        // worst vertex deviation, 0 for full detail, never smaller than the level before
+};
+
+struct LodMesh {
+    std::vector<float> vertices;   // interleaved, position in the first three floats
+    uint32_t stride = 5;           // floats per vertex
+    std::vector<uint32_t> indices; // every level back to back, full detail first
+    std::vector<LodLevel> levels;
+    glm::vec3 center = glm::vec3(0.0f); // bounding sphere, what selection measures distance to
+    float radius = 0.0f;
+
+    size_t VertexCount() const { return stride > 0 ? vertices.size() / stride : 0; }
+};
+
+enum Lod_Flags : unsigned int {
+    LOD_LOCK_BORDER = 1 // open edges stay exactly where they are
+};
+
+enum Lod_Vertex : uint8_t {
+    LOD_VERTEX_MANIFOLD, // collapses onto any neighbour
+    LOD_VERTEX_BORDER,   // on an open edge, only slides along it
+    LOD_VERTEX_LOCKED    // seams, corners, non-manifold spots and locked borders
+};
+
+// Open edges get a plane through them, perpendicular to their triangle, this much heavier than area
+const double LOD_BORDER_WEIGHT = 10.0;
+// A collapse can't turn a triangle's normal further than acos of this
+const float LOD_MIN_NORMAL_COS = 0.25f;
+
+// Sum of squared plane distances, Q(p) = p'Ap + 2b'p + c
+struct LodQuadric {
+    double a00 = 0.0, a11 = 0.0, a22 = 0.0, a01 = 0.0, a02 = 0.0, a12 = 0.0;
+    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+    double c = 0.0;
+    double area = 0.0; // triangle area only, borders don't dilute the average
+
+    void AddPlane(const glm::vec3 &normal, float distance, double weight)
+    {
+        double x = normal.x, y = normal.y, z = normal.z, d = distance;
+        a00 += weight * x * x; a11 += weight * y * y; a22 += weight * z * z;
+        a01 += weight * x * y; a02 += weight * x * z; a12 += weight * y * z;
+        b0 += weight * x * d; b1 += weight * y * d; b2 += weight * z * d;
+        c += weight * d * d;
+    }
+
+    void Add(const LodQuadric &other)
+    {
+        a00 += other.a00; a11 += other.a11; a22 += other.a22;
+        a01 += other.a01; a02 += other.a02; a12 += other.a12;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        area += other.area;
+    }
+
+    // RMS distance of point from the planes, in mesh units
+    float Error(const glm::vec3 &point) const
+    {
+        double x = point.x, y = point.y, z = point.z;
+        double q = a00 * x * x + a11 * y * y + a22 * z * z
+                 + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                 + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        q = std::max(q, 0.0);
+        if (area <= 0.0)
+            return q > 0.0 ? (float)std::sqrt(q) : 0.0f;
+        return (float)std::sqrt(q / area);
+    }
+};
+
+namespace LodDetail {
+
+inline uint64_t EdgeKey(uint32_t a, uint32_t b) { return ((uint64_t)a << 32) | b; }
+
+inline glm::vec3 Position(const float* vertices, uint32_t stride, uint32_t vertex)
+{
+    const float* p = vertices + (size_t)vertex * stride;
+    return glm::vec3(p[0], p[1], p[2]);
+}
+
+inline float LengthSquared(const glm::vec3 &v) { return glm::dot(v, v); }
+
+// Closest point on the triangle (Ericson, Real-Time Collision Detection 5.1.5), squared distance to it
+inline float PointTriangleDistanceSquared(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+    glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f)
+        return LengthSquared(ap);
+
+    glm::vec3 bp = p - b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3)
+        return LengthSquared(bp);
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        return LengthSquared(ap - ab * (d1 / (d1 - d3)));
+
+    glm::vec3 cp = p - c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6)
+        return LengthSquared(cp);
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        return LengthSquared(ap - ac * (d2 / (d2 - d6)));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+        return LengthSquared(bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+
+    float denominator = 1.0f / (va + vb + vc);
+    return LengthSquared(ap - ab * (vb * denominator) - ac * (vc * denominator));
+}
+
+// Every vertex points at the first vertex with the same position, bitwise (-0 folded into 0)
+inline std::vector<uint32_t> PositionRemap(const float* vertices, size_t vertex_count, uint32_t stride)
+{
+    struct Key {
+        uint32_t x, y, z;
+        bool operator==(const Key &other) const { return x == other.x && y == other.y && z == other.z; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key &key) const
+        {
+            uint64_t h = key.x * 73856093ull ^ key.y * 19349663ull ^ key.z * 83492791ull;
+            return (size_t)(h ^ (h >> 29));
+        }
+    };
+
+    std::vector<uint32_t> remap(vertex_count);
+    std::unordered_map<Key, uint32_t, KeyHash> first;
+    first.reserve(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        const float* p = vertices + (size_t)v * stride;
+        Key key;
+        float x = p[0] + 0.0f, y = p[1] + 0.0f, z = p[2] + 0.0f;
+        memcpy(&key.x, &x, 4);
+        memcpy(&key.y, &y, 4);
+        memcpy(&key.z, &z, 4);
+        remap[v] = first.emplace(key, v).first->second;
+    }
+    return remap;
+}
+
+// Uniform grid over a level's triangles, for the nearest one to a point. Cells are about one
+// triangle across, every triangle sits in the cells its bounding box touches.
+class TriangleGrid
+{
+public:
+    void Build(const float* vertices, uint32_t stride, const std::vector<uint32_t> &indices)
+    {
+        this->vertices = vertices;
+        this->stride = stride;
+        this->indices = indices.data();
+        size_t triangle_count = indices.size() / 3;
+
+        glm::vec3 low(INFINITY), high(-INFINITY);
+        double extent = 0.0;
+        for (size_t t = 0; t < triangle_count; ++t) {
+            glm::vec3 a = Position(vertices, stride, indices[t * 3]);
+            glm::vec3 b = Position(vertices, stride, indices[t * 3 + 1]);
+            glm::vec3 c = Position(vertices, stride, indices[t * 3 + 2]);
+            glm::vec3 box = glm::max(a, glm::max(b, c)) - glm::min(a, glm::min(b, c));
+            extent += std::max(box.x, std::max(box.y, box.z));
+            low = glm::min(low, glm::min(a, glm::min(b, c)));
+            high = glm::max(high, glm::max(a, glm::max(b, c)));
+        }
+        origin = low;
+        cell = triangle_count > 0 ? (float)(extent / triangle_count) : 1.0f;
+        if (!(cell > 0.0f))
+            cell = std::max(std::max(high.x - low.x, high.y - low.y), std::max(high.z - low.z, 1.0f));
+        // A few huge triangles shouldn't make for millions of empty cells
+        for (;;) {
+            for (int axis = 0; axis < 3; ++axis)
+                size[axis] = (int)((high[axis] - low[axis]) / cell) + 1;
+            if ((double)size[0] * size[1] * size[2] <= 4.0 * triangle_count + 64.0)
+                break;
+            cell *= 1.5f;
+        }
+
+        first_triangle.assign((size_t)size[0] * size[1] * size[2] + 1, 0);
+        for (int pass = 0; pass < 2; ++pass) {
+            std::vector<uint32_t> cursor;
+            if (pass == 1) {
+                for (size_t i = 1; i < first_triangle.size(); ++i)
+                    first_triangle[i] += first_triangle[i - 1];
+                triangles.resize(first_triangle.back());
+                cursor.assign(first_triangle.begin(), first_triangle.end() - 1);
+            }
+            for (size_t t = 0; t < triangle_count; ++t) {
+                glm::vec3 a = Position(vertices, stride, indices[t * 3]);
+                glm::vec3 b = Position(vertices, stride, indices[t * 3 + 1]);
+                glm::vec3 c = Position(vertices, stride, indices[t * 3 + 2]);
+                int from[3], to[3];
+                cellOf(glm::min(a, glm::min(b, c)), from);
+                cellOf(glm::max(a, glm::max(b, c)), to);
+                for (int z = from[2]; z <= to[2]; ++z)
+                    for (int y = from[1]; y <= to[1]; ++y)
+                        for (int x = from[0]; x <= to[0]; ++x) {
+                            size_t index = cellIndex(x, y, z);
+                            if (pass == 0)
+                                ++first_triangle[index + 1];
+                            else
+                                triangles[cursor[index]++] = (uint32_t)t;
+                        }
+            }
+        }
+        looked_at.assign(triangle_count, 0);
+        query = 0;
+    }
+
+    // Squared distance to the nearest triangle, INFINITY without any. Rings of cells go out from
+    // the point's cell until no cell further out can hold anything closer.
+    float NearestSquared(const glm::vec3 &p)
+    {
+        ++query;
+        int center[3];
+        cellOf(p, center);
+        int rings = std::max(size[0], std::max(size[1], size[2]));
+        float nearest = INFINITY;
+        for (int ring = 0; ring < rings; ++ring) {
+            // The point is inside its cell (or clamped onto it), ring r is at least r - 1 cells away
+            float reach = (float)(ring - 1) * cell;
+            if (ring > 1 && nearest <= reach * reach)
+                break;
+            for (int z = std::max(center[2] - ring, 0); z <= std::min(center[2] + ring, size[2] - 1); ++z)
+                for (int y = std::max(center[1] - ring, 0); y <= std::min(center[1] + ring, size[1] - 1); ++y)
+                    for (int x = std::max(center[0] - ring, 0); x <= std::min(center[0] + ring, size[0] - 1); ++x) {
+                        int at[3] = { x, y, z };
+                        if (std::max(std::abs(x - center[0]), std::max(std::abs(y - center[1]), std::abs(z - center[2]))) != ring)
+                            continue;
+
+                        // Nothing in a cell is closer than its box
+                        float box = 0.0f;
+                        for (int axis = 0; axis < 3; ++axis) {
+                            float low = origin[axis] + (float)at[axis] * cell;
+                            float gap = std::max(std::max(low - p[axis], p[axis] - low - cell), 0.0f);
+                            box += gap * gap;
+                        }
+                        if (box >= nearest)
+                            continue;
+
+                        size_t index = cellIndex(x, y, z);
+                        for (uint32_t i = first_triangle[index]; i < first_triangle[index + 1]; ++i) {
+                            uint32_t t = triangles[i];
+                            if (looked_at[t] == query)
+                                continue;
+                            looked_at[t] = query;
+                            nearest = std::min(nearest, PointTriangleDistanceSquared(p, Position(vertices, stride, indices[t * 3]),
+                                Position(vertices, stride, indices[t * 3 + 1]), Position(vertices, stride, indices[t * 3 + 2])));
+                        }
+                    }
+        }
+        return nearest;
+    }
+
+private:
+    const float* vertices = nullptr;
+    uint32_t stride = 0;
+    const uint32_t* indices = nullptr;
+    glm::vec3 origin = glm::vec3(0.0f);
+    float cell = 1.0f;
+    int size[3] = { 1, 1, 1 };
+    std::vector<uint32_t> first_triangle; // per cell, into triangles
+    std::vector<uint32_t> triangles;
+    std::vector<uint32_t> looked_at;      // query that last tested a triangle, triangles span cells
+    uint32_t query = 0;
+
+    void cellOf(const glm::vec3 &p, int cell_of[3]) const
+    {
+        for (int axis = 0; axis < 3; ++axis)
+            cell_of[axis] = std::clamp((int)std::floor((p[axis] - origin[axis]) / cell), 0, size[axis] - 1);
+    }
+
+    size_t cellIndex(int x, int y, int z) const { return ((size_t)z * size[1] + y) * size[0] + x; }
+};
+
+// Largest distance from a vertex of `full` to the surface of `level`, both index the same vertices
+inline float MaxDeviation(const float* vertices, uint32_t stride, std::span<const uint32_t> full, const std::vector<uint32_t> &level)
+{
+    if (level.empty())
+        return 0.0f;
+    uint32_t vertex_count = 0;
+    for (uint32_t index : full)
+        vertex_count = std::max(vertex_count, index + 1);
+
+    // 1 still to measure, 2 measured or a corner of the level, right on its surface
+    std::vector<uint8_t> state(vertex_count, 0);
+    for (uint32_t index : full)
+        state[index] = 1;
+    for (uint32_t index : level)
+        state[index] = 2;
+
+    TriangleGrid grid;
+    grid.Build(vertices, stride, level);
+    float worst = 0.0f; // squared
+    for (uint32_t index : full) {
+        if (state[index] != 1)
+            continue;
+        state[index] = 2;
+        worst = std::max(worst, grid.NearestSquared(Position(vertices, stride, index)));
+    }
+    return std::sqrt(worst);
+}
+
+// Called with the indices and their measured error once a target is used up
+typedef std::function<void(const std::vector<uint32_t> &indices, float error)> LevelDone;
+
+// Simplifies through increasing targets in one go. The quadrics keep adding up, so every
+// level's collapses are still costed against the full mesh.
+inline void SimplifyLevels(const float* vertices, size_t vertex_count, uint32_t stride,
+    std::span<const uint32_t> indices, std::span<const float> targets, size_t target_index_count,
+    unsigned int flags, const LevelDone &level_done)
+{
+    std::vector<uint32_t> result(indices.begin(), indices.end());
+    if (vertex_count == 0 || result.size() < 3) {
+        for (size_t i = 0; i < targets.size(); ++i)
+            level_done(result, 0.0f);
+        return;
+    }
+
+    // Seams: more than one vertex at a position
+    std::vector<uint32_t> remap = PositionRemap(vertices, vertex_count, stride);
+    std::vector<uint32_t> twins(vertex_count, 0);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+        ++twins[remap[v]];
+
+    // Open edges are the ones whose reverse nobody has, seams don't count since they share positions
+    std::unordered_map<uint64_t, uint32_t> directed;
+    directed.reserve(result.size());
+    for (size_t i = 0; i < result.size(); i += 3) {
+        for (int e = 0; e < 3; ++e)
+            ++directed[EdgeKey(remap[result[i + e]], remap[result[i + (e + 1) % 3]])];
+    }
+
+    std::vector<uint32_t> border_edges(vertex_count, 0);
+    std::vector<bool> non_manifold(vertex_count, false);
+    for (const auto &entry : directed) {
+        uint32_t a = (uint32_t)(entry.first >> 32), b = (uint32_t)entry.first;
+        auto reverse = directed.find(EdgeKey(b, a));
+        if (entry.second > 1 || (reverse != directed.end() && reverse->second > 1))
+            non_manifold[a] = non_manifold[b] = true;
+        if (reverse == directed.end()) {
+            ++border_edges[a];
+            ++border_edges[b];
+        }
+    }
+
+    std::vector<Lod_Vertex> kind(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; ++v) {
+        uint32_t r = remap[v];
+        if (twins[r] > 1 || non_manifold[r])
+            kind[v] = LOD_VERTEX_LOCKED;
+        else if (border_edges[r] == 0)
+            kind[v] = LOD_VERTEX_MANIFOLD;
+        else if (border_edges[r] == 2 && !(flags & LOD_LOCK_BORDER))
+            kind[v] = LOD_VERTEX_BORDER;
+        else
+            kind[v] = LOD_VERTEX_LOCKED;
+    }
+
+    // Planes of the triangles around every position, plus the border planes
+    std::vector<LodQuadric> quadrics(vertex_count);
+    for (size_t i = 0; i < result.size(); i += 3) {
+        uint32_t corners[3] = { remap[result[i]], remap[result[i + 1]], remap[result[i + 2]] };
+        glm::vec3 p0 = Position(vertices, stride, corners[0]);
+        glm::vec3 p1 = Position(vertices, stride, corners[1]);
+        glm::vec3 p2 = Position(vertices, stride, corners[2]);
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length <= 0.0f)
+            continue;
+        normal /= length;
+
+        double area = length * 0.5;
+        for (uint32_t corner : corners) {
+            quadrics[corner].AddPlane(normal, -glm::dot(normal, p0), area);
+            quadrics[corner].area += area;
+        }
+
+        for (int e = 0; e < 3; ++e) {
+            uint32_t a = corners[e], b = corners[(e + 1) % 3];
+            if (directed.count(EdgeKey(b, a)))
+                continue;
+            glm::vec3 pa = Position(vertices, stride, a);
+            glm::vec3 edge = Position(vertices, stride, b) - pa;
+            glm::vec3 side = glm::cross(edge, normal);
+            float side_length = glm::length(side);
+            if (side_length <= 0.0f)
+                continue;
+            side /= side_length;
+            double weight = (double)glm::dot(edge, edge) * LOD_BORDER_WEIGHT;
+            quadrics[a].AddPlane(side, -glm::dot(side, pa), weight);
+            quadrics[b].AddPlane(side, -glm::dot(side, pa), weight);
+        }
+    }
+
+    struct Candidate {
+        uint32_t from;
+        uint32_t to;
+        float error;
+    };
+    std::vector<Candidate> candidates;
+    std::vector<uint32_t> first_triangle(vertex_count + 1);
+    std::vector<uint32_t> triangles_of;
+    std::vector<uint32_t> collapse(vertex_count);
+    std::vector<bool> touched(vertex_count);
+    std::vector<uint32_t> ring_from, ring_to;
+
+    for (float target_error : targets) {
+        while (result.size() > target_index_count) {
+            size_t triangle_count = result.size() / 3;
+
+            // Triangles around every vertex, by position so seam twins see each other's
+            std::fill(first_triangle.begin(), first_triangle.end(), 0);
+            for (uint32_t index : result)
+                ++first_triangle[remap[index] + 1];
+            for (size_t v = 0; v < vertex_count; ++v)
+                first_triangle[v + 1] += first_triangle[v];
+            triangles_of.resize(result.size());
+            {
+                std::vector<uint32_t> cursor(first_triangle.begin(), first_triangle.end() - 1);
+                for (size_t i = 0; i < result.size(); ++i)
+                    triangles_of[cursor[remap[result[i]]]++] = (uint32_t)(i / 3);
+            }
+
+            // Triangles on the edge between two positions, open edges have one
+            auto edgeTriangles = [&](uint32_t a_r, uint32_t b_r) {
+                uint32_t count = 0;
+                for (uint32_t t = first_triangle[a_r]; t < first_triangle[a_r + 1]; ++t) {
+                    const uint32_t* triangle = &result[(size_t)triangles_of[t] * 3];
+                    count += remap[triangle[0]] == b_r || remap[triangle[1]] == b_r || remap[triangle[2]] == b_r;
+                }
+                return count;
+            };
+
+            candidates.clear();
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (int e = 0; e < 3; ++e) {
+                    uint32_t a = result[i + e], b = result[i + (e + 1) % 3];
+                    for (int direction = 0; direction < 2; ++direction) {
+                        // Inner edges show up the other way round in the triangle next door, open ones don't
+                        uint32_t from = direction ? b : a, to = direction ? a : b;
+                        if (kind[from] == LOD_VERTEX_LOCKED || (direction == 1 && kind[from] != LOD_VERTEX_BORDER))
+                            continue;
+                        if (kind[from] == LOD_VERTEX_BORDER && edgeTriangles(remap[from], remap[to]) != 1)
+                            continue;
+
+                        LodQuadric merged = quadrics[remap[from]];
+                        merged.Add(quadrics[remap[to]]);
+                        float error = merged.Error(Position(vertices, stride, to));
+                        if (error <= target_error)
+                            candidates.push_back({ from, to, error });
+                    }
+                }
+            }
+            if (candidates.empty())
+                break;
+            std::sort(candidates.begin(), candidates.end(), [](const Candidate &x, const Candidate &y) { return x.error < y.error; });
+
+            for (uint32_t v = 0; v < vertex_count; ++v)
+                collapse[v] = v;
+            std::fill(touched.begin(), touched.end(), false);
+
+            bool collapsed = false;
+            for (const Candidate &candidate : candidates) {
+                if (triangle_count * 3 <= target_index_count)
+                    break;
+                uint32_t from = candidate.from, to = candidate.to;
+                uint32_t from_r = remap[from], to_r = remap[to];
+                if (touched[from_r] || touched[to_r])
+                    continue;
+
+                // Link condition: the only neighbours both ends share are the tips of the triangles on the edge
+                ring_from.clear();
+                ring_to.clear();
+                uint32_t shared_triangles = 0;
+                for (uint32_t t = first_triangle[from_r]; t < first_triangle[from_r + 1]; ++t) {
+                    const uint32_t* triangle = &result[(size_t)triangles_of[t] * 3];
+                    bool on_edge = false;
+                    for (int k = 0; k < 3; ++k)
+                        on_edge |= remap[triangle[k]] == to_r;
+                    shared_triangles += on_edge;
+                    for (int k = 0; k < 3; ++k)
+                        ring_from.push_back(remap[triangle[k]]);
+                }
+                for (uint32_t t = first_triangle[to_r]; t < first_triangle[to_r + 1]; ++t) {
+                    const uint32_t* triangle = &result[(size_t)triangles_of[t] * 3];
+                    for (int k = 0; k < 3; ++k)
+                        ring_to.push_back(remap[triangle[k]]);
+                }
+                std::sort(ring_from.begin(), ring_from.end());
+                ring_from.erase(std::unique(ring_from.begin(), ring_from.end()), ring_from.end());
+                std::sort(ring_to.begin(), ring_to.end());
+                ring_to.erase(std::unique(ring_to.begin(), ring_to.end()), ring_to.end());
+                uint32_t common = 0;
+                for (uint32_t v : ring_from)
+                    common += v != from_r && v != to_r && std::binary_search(ring_to.begin(), ring_to.end(), v);
+                if (common > shared_triangles)
+                    continue;
+
+                // No triangle that survives may turn over
+                glm::vec3 from_position = Position(vertices, stride, from);
+                glm::vec3 to_position = Position(vertices, stride, to);
+                bool flips = false;
+                for (uint32_t t = first_triangle[from_r]; t < first_triangle[from_r + 1] && !flips; ++t) {
+                    const uint32_t* triangle = &result[(size_t)triangles_of[t] * 3];
+                    int k = 0;
+                    while (remap[triangle[k]] != from_r)
+                        ++k;
+                    uint32_t b = triangle[(k + 1) % 3], c = triangle[(k + 2) % 3];
+                    if (remap[b] == to_r || remap[c] == to_r)
+                        continue;
+                    glm::vec3 pb = Position(vertices, stride, b), pc = Position(vertices, stride, c);
+                    glm::vec3 before = glm::cross(pb - from_position, pc - from_position);
+                    glm::vec3 after = glm::cross(pb - to_position, pc - to_position);
+                    flips = glm::dot(before, after) <= LOD_MIN_NORMAL_COS * glm::length(before) * glm::length(after);
+                }
+                if (flips)
+                    continue;
+
+                collapse[from] = to;
+                quadrics[to_r].Add(quadrics[from_r]);
+                triangle_count -= shared_triangles;
+                collapsed = true;
+
+                // Every triangle that just changed is off limits for the rest of the pass
+                for (uint32_t v : ring_from)
+                    touched[v] = true;
+            }
+            if (!collapsed)
+                break;
+
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                uint32_t a = collapse[result[i]], b = collapse[result[i + 1]], c = collapse[result[i + 2]];
+                if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+                    continue;
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+        }
+        level_done(result, MaxDeviation(vertices, stride, indices, result));
+    }
+}
+
+}
+
+// Indices of a simplified copy of `indices`. Stops once no collapse stays under target_error or
+// the index count is down to target_index_count. result_error gets its measured error.
+inline std::vector<uint32_t> SimplifyMesh(const float* vertices, size_t vertex_count, uint32_t stride,
+    std::span<const uint32_t> indices, float target_error, size_t target_index_count = 0,
+    unsigned int flags = 0, float* result_error = nullptr)
+{
+    std::vector<uint32_t> simplified;
+    float error = 0.0f;
+    LodDetail::SimplifyLevels(vertices, vertex_count, stride, indices, std::span<const float>(&target_error, 1), target_index_count, flags,
+        [&](const std::vector<uint32_t> &level, float level_error) { simplified = level; error = level_error; });
+    if (result_error)
+        *result_error = error;
+    return simplified;
+}
+
+// Simplifies `indices` (full detail on input) through the target errors, in increasing order,
+// and appends every level to it. Levels that don't get at least 10% smaller than the one before
+// are skipped. Returns the levels, full detail first.
+inline std::vector<LodLevel> BuildLods(const float* vertices, size_t vertex_count, uint32_t stride,
+    std::vector<uint32_t> &indices, const std::vector<float> &target_errors, unsigned int flags = 0)
+{
+    std::vector<LodLevel> levels;
+    uint32_t base_count = (uint32_t)indices.size();
+    levels.push_back({ 0, base_count, 0.0f });
+
+    std::vector<float> targets = target_errors;
+    std::sort(targets.begin(), targets.end());
+    std::vector<uint32_t> simplified;
+    LodDetail::SimplifyLevels(vertices, vertex_count, stride, std::span<const uint32_t>(indices.data(), base_count), targets, 0, flags,
+        [&](const std::vector<uint32_t> &level, float error) {
+            if (level.empty() || level.size() * 10 > (size_t)levels.back().index_count * 9)
+                return;
+            simplified.insert(simplified.end(), level.begin(), level.end());
+            levels.push_back({ base_count + (uint32_t)(simplified.size() - level.size()), (uint32_t)level.size(), std::max(error, levels.back().error) });
+        });
+    indices.insert(indices.end(), simplified.begin(), simplified.end());
+    return levels;
+}
+
+// Bounding box center, radius to the furthest vertex
+inline void ComputeLodBounds(LodMesh &mesh)
+{
+    size_t vertex_count = mesh.VertexCount();
+    mesh.center = glm::vec3(0.0f);
+    mesh.radius = 0.0f;
+    if (vertex_count == 0)
+        return;
+
+    glm::vec3 low = LodDetail::Position(mesh.vertices.data(), mesh.stride, 0), high = low;
+    for (uint32_t v = 1; v < vertex_count; ++v) {
+        glm::vec3 p = LodDetail::Position(mesh.vertices.data(), mesh.stride, v);
+        low = glm::min(low, p);
+        high = glm::max(high, p);
+    }
+    mesh.center = (low + high) * 0.5f;
+    for (uint32_t v = 0; v < vertex_count; ++v)
+        mesh.radius = std::max(mesh.radius, glm::length(LodDetail::Position(mesh.vertices.data(), mesh.stride, v) - mesh.center));
+}
+
+// mesh.indices holds full detail on input
+inline void BuildLods(LodMesh &mesh, const std::vector<float> &target_errors, unsigned int flags = 0)
+{
+    mesh.levels = BuildLods(mesh.vertices.data(), mesh.VertexCount(), mesh.stride, mesh.indices, target_errors, flags);
+    ComputeLodBounds(mesh);
+}
+
+///
+/// Runtime selection
+///
+struct LodStats {
+    unsigned int objects = 0;
+    unsigned int switches = 0;   // objects that changed level this frame
+    uint64_t full_triangles = 0; // what everything at full detail would have cost
+    uint64_t triangles = 0;      // what the picked levels cost
+};
+
+// Closer than this counts as this close, the camera inside a bounding sphere wants full detail anyway
+const float LOD_MIN_DISTANCE = 1e-3f;
+
+class LodSelector
+{
+public:
+    float ThresholdPixels = 1.0f; // most a level may be off by on screen
+    float Hysteresis = 0.25f;     // going coarser needs the error this much under the threshold
+    bool Enabled = true;          // false keeps everything at full detail
+    LodStats Stats;
+
+    // Once per frame before any Select()
+    void Begin(const glm::vec3 &eye, const glm::mat4 &projection, float viewport_height)
+    {
+        this->eye = eye;
+        // projection[1][1] is cot(fovy / 2): one unit at distance one covers that many half viewports
+        pixel_scale = std::abs(projection[1][1]) * viewport_height * 0.5f;
+        Stats = LodStats();
+    }
+
+    // Pixels `error` covers on screen at a bounding sphere
+    float ScreenError(float error, const glm::vec3 &center, float radius) const
+    {
+        float distance = std::max(glm::length(center - eye) - radius, LOD_MIN_DISTANCE);
+        return error * pixel_scale / distance;
+    }
+
+    // Level to draw, given the one drawn last frame
+    uint32_t Select(const std::vector<LodLevel> &levels, uint32_t current, const glm::vec3 &center, float radius)
+    {
+        if (levels.empty())
+            return 0;
+        uint32_t count = (uint32_t)levels.size();
+        current = std::min(current, count - 1);
+
+        uint32_t level = 0;
+        if (Enabled) {
+            float distance = std::max(glm::length(center - eye) - radius, LOD_MIN_DISTANCE);
+            auto fits = [&](uint32_t i, float limit) { return levels[i].error * pixel_scale <= limit * distance; };
+
+            level = current;
+            if (!fits(current, ThresholdPixels)) {
+                // Too coarse: the coarsest finer level that fits, full detail always does
+                while (level > 0 && !fits(level, ThresholdPixels))
+                    --level;
+            } else {
+                // Coarser only once comfortably under, so sitting on the threshold doesn't flicker
+                while (level + 1 < count && fits(level + 1, ThresholdPixels * (1.0f - Hysteresis)))
+                    ++level;
+            }
+        }
+
+        ++Stats.objects;
+        Stats.switches += level != current;
+        Stats.full_triangles += levels[0].index_count / 3;
+        Stats.triangles += levels[level].index_count / 3;
+        return level;
+    }
+
+private:
+    glm::vec3 eye = glm::vec3(0.0f);
+    float pixel_scale = 1.0f;
+};
+
+///
+/// .lod files, written by GreyHeavens_lod, everything little endian:
+///
+///   LodFileHeader
+///   LodLevel[level_count]
+///   float vertices[vertex_count * stride]
+///   uint32_t indices[index_count]
+///
+const char     LOD_MAGIC[4] = { 'G', 'H', 'L', 'D' };
+const uint32_t LOD_VERSION  = 1;
+
+struct LodFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t stride;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t level_count;
+};
+
+static_assert(sizeof(LodFileHeader) == 24, "LodFileHeader layout is part of the file format");
+static_assert(sizeof(LodLevel) == 12, "LodLevel layout is part of the file format");
+
+inline std::vector<uint8_t> SerializeLodMesh(const LodMesh &mesh)
+{
+    LodFileHeader header;
+    memcpy(header.magic, LOD_MAGIC, 4);
+    header.version = LOD_VERSION;
+    header.stride = mesh.stride;
+    header.vertex_count = (uint32_t)mesh.VertexCount();
+    header.index_count = (uint32_t)mesh.indices.size();
+    header.level_count = (uint32_t)mesh.levels.size();
+
+    size_t vertex_bytes = (size_t)header.vertex_count * header.stride * sizeof(float);
+    std::vector<uint8_t> data(sizeof(header) + mesh.levels.size() * sizeof(LodLevel) + vertex_bytes + mesh.indices.size() * sizeof(uint32_t));
+    uint8_t* out = data.data();
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    memcpy(out, mesh.levels.data(), mesh.levels.size() * sizeof(LodLevel));
+    out += mesh.levels.size() * sizeof(LodLevel);
+    memcpy(out, mesh.vertices.data(), vertex_bytes);
+    out += vertex_bytes;
+    memcpy(out, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+    return data;
+}
+
+// False on anything malformed, mesh is left half filled then
+inline bool ParseLodMesh(std::span<const uint8_t> data, LodMesh &mesh)
+{
+    LodFileHeader header;
+    if (data.size() < sizeof(header))
+        return false;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, LOD_MAGIC, 4) != 0 || header.version != LOD_VERSION || header.stride < 3)
+        return false;
+
+    size_t level_bytes = (size_t)header.level_count * sizeof(LodLevel);
+    size_t vertex_bytes = (size_t)header.vertex_count * header.stride * sizeof(float);
+    size_t index_bytes = (size_t)header.index_count * sizeof(uint32_t);
+    if (data.size() != sizeof(header) + level_bytes + vertex_bytes + index_bytes)
+        return false;
+
+    const uint8_t* in = data.data() + sizeof(header);
+    mesh.stride = header.stride;
+    mesh.levels.resize(header.level_count);
+    memcpy(mesh.levels.data(), in, level_bytes);
+    in += level_bytes;
+    mesh.vertices.resize((size_t)header.vertex_count * header.stride);
+    memcpy(mesh.vertices.data(), in, vertex_bytes);
+    in += vertex_bytes;
+    mesh.indices.resize(header.index_count);
+    memcpy(mesh.indices.data(), in, index_bytes);
+
+    for (const LodLevel &level : mesh.levels) {
+        if ((uint64_t)level.index_offset + level.index_count > header.index_count)
+            return false;
+    }
+    for (uint32_t index : mesh.indices) {
+        if (index >= header.vertex_count)
+            return false;
+    }
+
+    // Bounds aren't stored
+    ComputeLodBounds(mesh);
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+/// Overdraw
+///
+/// How many fragments the opaque pass shades per pixel, counted with
+/// GL_SAMPLES_PASSED queries around the shading draws. Fragments rejected by
+/// the depth test before shading don't count, so this is what front to back
+/// ordering and the depth prepass are supposed to bring down to ~1.
+///
+/// Results are read OVERDRAW_QUERIES frames late so the CPU never waits on them.
+
+// How opaque draws are ordered before submission
+enum Opaque_Order {
+    ORDER_SUBMISSION,    // boxes as placed, chunks grouped by material
+    ORDER_FRONT_TO_BACK  // nearest first by view depth, so the depth test rejects more
+};
+
+struct OverdrawStats {
+    uint64_t shaded_fragments = 0;
+    uint64_t pixels = 0;
+    double average = 0.0;  // shaded fragments per pixel
+};
+
+const int OVERDRAW_QUERIES = 4;
+
+class OverdrawCounter
+{
+public:
+    OverdrawStats Stats;
+
+    void Init()
+    {
+        glGenQueries(OVERDRAW_QUERIES, queries);
+    }
+
+    void Begin(uint64_t pixels)
+    {
+        // The last one in this slot is OVERDRAW_QUERIES frames old, done by now in practice
+        if (pending[current]) {
+            GLuint64 fragments = 0;
+            glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &fragments);
+            Stats.shaded_fragments = fragments;
+            Stats.pixels = query_pixels[current];
+            Stats.average = Stats.pixels > 0 ? (double)fragments / (double)Stats.pixels : 0.0;
+        }
+
+        query_pixels[current] = pixels;
+        glBeginQuery(GL_SAMPLES_PASSED, queries[current]);
+    }
+
+    void End()
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        pending[current] = true;
+        current = (current + 1) % OVERDRAW_QUERIES;
+    }
+
+    void Release()
+    {
+        glDeleteQueries(OVERDRAW_QUERIES, queries);
+        for (int i = 0; i < OVERDRAW_QUERIES; ++i) {
+            queries[i] = 0;
+            pending[i] = false;
+        }
+    }
+
+private:
+    GLuint queries[OVERDRAW_QUERIES] = {};
+    uint64_t query_pixels[OVERDRAW_QUERIES] = {};
+    bool pending[OVERDRAW_QUERIES] = {};
+    int current = 0;
+};
@@ -0,0 +1,540 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Utils/camera.hpp>
+#include <Utils/job_system.hpp>
+#include <Utils/resource_manager.hpp>
+#include <Utils/shader.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GREYHEAVENS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+/// Particles
+///
+/// One ParticleSystem is a fixed capacity pool, stored as structure of arrays
+/// (one 64 byte aligned stream per field) so the kernels touch only what they
+/// need and run 4 particles at a time with SSE2. Without SSE2 (or with
+/// UseSIMD off) the same kernels run one particle at a time.
+///
+/// Update(dt), split across the job system in ranges:
+/// - integrate: gravity, drag, position, age
+/// - compact: dead particles are squeezed out of each range while integrating,
+///   then the holes that end up below the new count are filled from the top.
+///   Only as many particles move as died, order is not kept.
+/// - emit: emitters append at the end, randomness is a per particle hash so
+///   results don't depend on the thread count.
+///
+/// Drawing is one instanced triangle strip, quads are built in particle.vert
+/// from the camera right/up vectors. Additive particles are drawn in pool order,
+/// alpha blended ones are radix sorted back to front on the CPU first.
+
+enum Particle_Blend {
+    PARTICLE_ADDITIVE,
+    PARTICLE_ALPHA
+};
+
+struct ParticleEmitter {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 velocity = glm::vec3(0.0f, 5.0f, 0.0f);
+    float spread = 1.0f;             // +- on each velocity axis
+    float rate = 1000.0f;            // per second
+    float lifetime = 2.0f;           // seconds
+    float lifetime_variance = 0.5f;  // +-
+    float size = 0.05f;              // half extent of the quad
+    uint32_t color = 0xFF3080FF;     // RGBA8, R in the low byte
+    float accumulator = 0.0f;        // fraction of a particle left over from last frame
+};
+
+// Mirrors the instanced attributes of particle.vert
+struct ParticleInstance {
+    float x, y, z, size;
+    uint32_t color;
+};
+
+struct ParticleStats {
+    size_t alive = 0;
+    size_t emitted = 0;  // this frame
+    size_t died = 0;     // this frame
+    size_t dropped = 0;  // this frame, pool was full
+    double update_ms = 0.0;
+    double pack_ms = 0.0;
+};
+
+class ParticleSystem
+{
+public:
+    glm::vec3 Gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+    float Drag = 0.1f;                  // fraction of velocity lost per second
+    Particle_Blend Blend = PARTICLE_ADDITIVE;
+    bool UseSIMD = true;
+    unsigned int MaxThreads = 0;        // 0 is the whole job system
+    std::vector<ParticleEmitter> Emitters;
+    ParticleStats Stats;
+
+    ParticleSystem(size_t capacity)
+    {
+        // A multiple of 4, the SIMD kernels never have to care about the end of a stream
+        this->capacity = (capacity + 3) & ~(size_t)3;
+        for (int stream = 0; stream < STREAM_COUNT; ++stream)
+            streams[stream].reset((float*)::operator new(this->capacity * sizeof(float), std::align_val_t(64)));
+        colors.reset((uint32_t*)::operator new(this->capacity * sizeof(uint32_t), std::align_val_t(64)));
+    }
+
+    size_t Count() const { return count; }
+    size_t Capacity() const { return capacity; }
+
+    void Clear() { count = 0; }
+
+    // Burst, on top of what the emitters do per second
+    void Emit(const ParticleEmitter &emitter, size_t amount)
+    {
+        size_t room = capacity - count;
+        size_t emitted = std::min(amount, room);
+        Stats.dropped += amount - emitted;
+        Stats.emitted += emitted;
+
+        size_t first = count;
+        uint32_t seed = ++emit_seed * 0x9E3779B9u;
+        GetJobSystem().ParallelFor(emitted, 4096, [&](size_t begin, size_t end) {
+            emitRange(emitter, first + begin, first + end, seed);
+        }, MaxThreads);
+        count += emitted;
+    }
+
+    void Update(float dt)
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t before = count;
+        Stats.emitted = Stats.dropped = 0;
+
+        // Integrate and compact each range
+        size_t range_count = std::clamp<size_t>(count / RANGE_SIZE, 1, MAX_RANGES);
+        ranges.resize(range_count);
+        for (size_t range = 0; range < range_count; ++range) {
+            // Multiples of 4 so the SIMD loop stays in step, the last range takes the tail
+            ranges[range].begin = (count * range / range_count) & ~(size_t)3;
+            ranges[range].end = range + 1 == range_count ? count : (count * (range + 1) / range_count) & ~(size_t)3;
+        }
+        GetJobSystem().ParallelFor(range_count, 1, [&](size_t begin, size_t end) {
+            for (size_t range = begin; range < end; ++range)
+                ranges[range].alive = integrateRange(ranges[range].begin, ranges[range].end, dt);
+        }, MaxThreads);
+        count = fillHoles();
+        Stats.died = before - count;
+
+        // Then emit, new particles start integrating next frame
+        for (ParticleEmitter &emitter : Emitters) {
+            float wanted = emitter.rate * dt + emitter.accumulator;
+            size_t amount = (size_t)wanted;
+            emitter.accumulator = wanted - (float)amount;
+            Emit(emitter, amount);
+        }
+
+        Stats.alive = count;
+        Stats.update_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Interleaves the pool into Instances(), sorted back to front for PARTICLE_ALPHA
+    void Pack(const glm::vec3 &eye, const glm::vec3 &front)
+    {
+        auto start = std::chrono::steady_clock::now();
+        instances.resize(count);
+        JobSystem &jobs = GetJobSystem();
+
+        const uint32_t* order = nullptr;
+        if (Blend == PARTICLE_ALPHA && count > 1) {
+            keys.resize(count);
+            jobs.ParallelFor(count, 16384, [&](size_t begin, size_t end) {
+                writeDepthKeys(begin, end, eye, front);
+            }, MaxThreads);
+            order = radixSort();
+        }
+
+        jobs.ParallelFor(count, 16384, [&](size_t begin, size_t end) {
+            packRange(begin, end, order);
+        }, MaxThreads);
+
+        Stats.pack_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const std::vector<ParticleInstance>& Instances() const { return instances; }
+
+    ///
+    /// GL side
+    ///
+    void Init()
+    {
+        ResourceManager &resources = GetResourceManager();
+        VAO = resources.CreateVertexArray();
+        VBO = resources.CreateBuffer(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+
+        glBindVertexArray(resources.Get(VAO));
+        glBindBuffer(GL_ARRAY_BUFFER, resources.Get(VBO));
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, x));
+        glEnableVertexAttribArray(0);
+        glVertexAttribDivisor(0, 1);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ParticleInstance), (void*)offsetof(ParticleInstance, color));
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glBindVertexArray(0);
+    }
+
+    // After the opaque pass and the skybox. Leaves depth writes on and blending off.
+    void Draw(Shader &shader, const Camera &camera, const glm::mat4 &view, const glm::mat4 &projection)
+    {
+        Pack(camera.Position, camera.Front);
+        if (instances.empty())
+            return;
+
+        ResourceManager &resources = GetResourceManager();
+        resources.BufferData(VBO, GL_ARRAY_BUFFER, instances.size() * sizeof(ParticleInstance), instances.data(), GL_STREAM_DRAW);
+
+        shader.use();
+        shader.setMat4("view", view);
+        shader.setMat4("projection", projection);
+        shader.setVec3("camera_right", camera.Right);
+        shader.setVec3("camera_up", camera.Up);
+
+        glEnable(GL_BLEND);
+        if (Blend == PARTICLE_ADDITIVE)
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        else
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+
+        glBindVertexArray(resources.Get(VAO));
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)instances.size());
+
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+    }
+
+    void Release()
+    {
+        ResourceManager &resources = GetResourceManager();
+        resources.Release(VAO);
+        resources.Release(VBO);
+        VAO = VBO = ResourceHandle();
+    }
+
+private:
+    enum Stream {
+        POSITION_X, POSITION_Y, POSITION_Z,
+        VELOCITY_X, VELOCITY_Y, VELOCITY_Z,
+        AGE, LIFETIME, SIZE,
+        STREAM_COUNT
+    };
+
+    struct AlignedDelete {
+        void operator()(void* pointer) const { ::operator delete(pointer, std::align_val_t(64)); }
+    };
+
+    struct Range {
+        size_t begin;
+        size_t end;
+        size_t alive; // compacted to [begin, begin + alive)
+    };
+
+    // Small enough to spread over every thread, big enough that the hole filling stays cheap
+    static constexpr size_t RANGE_SIZE = 16384;
+    static constexpr size_t MAX_RANGES = 256;
+
+    size_t capacity = 0;
+    size_t count = 0;
+    std::unique_ptr<float, AlignedDelete> streams[STREAM_COUNT];
+    std::unique_ptr<uint32_t, AlignedDelete> colors;
+    std::vector<Range> ranges;
+    uint32_t emit_seed = 0;
+
+    std::vector<ParticleInstance> instances;
+    std::vector<uint32_t> keys, scratch_keys, order, scratch_order;
+
+    ResourceHandle VAO;
+    ResourceHandle VBO;
+
+    float* stream(Stream which) { return streams[which].get(); }
+
+    // Per particle seed, then xorshift for the rest of its numbers
+    static uint32_t hash(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7FEB352Du;
+        x ^= x >> 15;
+        x *= 0x846CA68Bu;
+        x ^= x >> 16;
+        return x | 1; // xorshift never leaves 0
+    }
+
+    static uint32_t xorshift(uint32_t &state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // [-1, 1) from the top 23 bits
+    static float signedUnit(uint32_t bits)
+    {
+        uint32_t mantissa = (bits >> 9) | 0x40000000u; // [2, 4)
+        float value;
+        memcpy(&value, &mantissa, sizeof(value));
+        return value - 3.0f;
+    }
+
+    void emitRange(const ParticleEmitter &emitter, size_t begin, size_t end, uint32_t seed)
+    {
+        float* px = stream(POSITION_X); float* py = stream(POSITION_Y); float* pz = stream(POSITION_Z);
+        float* vx = stream(VELOCITY_X); float* vy = stream(VELOCITY_Y); float* vz = stream(VELOCITY_Z);
+        float* age = stream(AGE); float* lifetime = stream(LIFETIME); float* size = stream(SIZE);
+        uint32_t* color = colors.get();
+
+        size_t i = begin;
+#ifdef GREYHEAVENS_SSE2
+        if (UseSIMD) {
+            const __m128i one_mantissa = _mm_set1_epi32(0x40000000);
+            const __m128 three = _mm_set1_ps(3.0f);
+            const __m128 spread = _mm_set1_ps(emitter.spread);
+            const __m128 variance = _mm_set1_ps(emitter.lifetime_variance);
+            auto next = [&](__m128i &state) {
+                state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+                state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+                state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+                return _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(state, 9), one_mantissa)), three);
+            };
+
+            for (; i + 4 <= end; i += 4) {
+                __m128i state = _mm_set_epi32((int)hash(seed + (uint32_t)i + 3), (int)hash(seed + (uint32_t)i + 2),
+                                              (int)hash(seed + (uint32_t)i + 1), (int)hash(seed + (uint32_t)i));
+                _mm_storeu_ps(vx + i, _mm_add_ps(_mm_set1_ps(emitter.velocity.x), _mm_mul_ps(next(state), spread)));
+                _mm_storeu_ps(vy + i, _mm_add_ps(_mm_set1_ps(emitter.velocity.y), _mm_mul_ps(next(state), spread)));
+                _mm_storeu_ps(vz + i, _mm_add_ps(_mm_set1_ps(emitter.velocity.z), _mm_mul_ps(next(state), spread)));
+                _mm_storeu_ps(lifetime + i, _mm_add_ps(_mm_set1_ps(emitter.lifetime), _mm_mul_ps(next(state), variance)));
+                _mm_storeu_ps(px + i, _mm_set1_ps(emitter.position.x));
+                _mm_storeu_ps(py + i, _mm_set1_ps(emitter.position.y));
+                _mm_storeu_ps(pz + i, _mm_set1_ps(emitter.position.z));
+                _mm_storeu_ps(age + i, _mm_setzero_ps());
+                _mm_storeu_ps(size + i, _mm_set1_ps(emitter.size));
+                _mm_storeu_si128((__m128i*)(color + i), _mm_set1_epi32((int)emitter.color));
+            }
+        }
+#endif
+        // Same numbers as the SIMD path
+        for (; i < end; ++i) {
+            uint32_t state = hash(seed + (uint32_t)i);
+            vx[i] = emitter.velocity.x + signedUnit(xorshift(state)) * emitter.spread;
+            vy[i] = emitter.velocity.y + signedUnit(xorshift(state)) * emitter.spread;
+            vz[i] = emitter.velocity.z + signedUnit(xorshift(state)) * emitter.spread;
+            lifetime[i] = emitter.lifetime + signedUnit(xorshift(state)) * emitter.lifetime_variance;
+            px[i] = emitter.position.x;
+            py[i] = emitter.position.y;
+            pz[i] = emitter.position.z;
+            age[i] = 0.0f;
+            size[i] = emitter.size;
+            color[i] = emitter.color;
+        }
+    }
+
+    void moveParticle(size_t to, size_t from)
+    {
+        for (int s = 0; s < STREAM_COUNT; ++s)
+            streams[s].get()[to] = streams[s].get()[from];
+        colors.get()[to] = colors.get()[from];
+    }
+
+    size_t integrateRange(size_t begin, size_t end, float dt)
+    {
+        float* px = stream(POSITION_X); float* py = stream(POSITION_Y); float* pz = stream(POSITION_Z);
+        float* vx = stream(VELOCITY_X); float* vy = stream(VELOCITY_Y); float* vz = stream(VELOCITY_Z);
+        float* age = stream(AGE); float* lifetime = stream(LIFETIME); float* size = stream(SIZE);
+        uint32_t* color = colors.get();
+
+        const float damping = std::max(0.0f, 1.0f - Drag * dt);
+        const glm::vec3 gravity = Gravity * dt;
+
+        // write never passes i, so a survivor only ever lands on something already read
+        size_t write = begin;
+        size_t i = begin;
+#ifdef GREYHEAVENS_SSE2
+        if (UseSIMD) {
+            const __m128 step = _mm_set1_ps(dt);
+            const __m128 damp = _mm_set1_ps(damping);
+            const __m128 gx = _mm_set1_ps(gravity.x), gy = _mm_set1_ps(gravity.y), gz = _mm_set1_ps(gravity.z);
+
+            for (; i + 4 <= end; i += 4) {
+                __m128 nvx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vx + i), gx), damp);
+                __m128 nvy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vy + i), gy), damp);
+                __m128 nvz = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vz + i), gz), damp);
+                __m128 npx = _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(nvx, step));
+                __m128 npy = _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(nvy, step));
+                __m128 npz = _mm_add_ps(_mm_loadu_ps(pz + i), _mm_mul_ps(nvz, step));
+                __m128 nage = _mm_add_ps(_mm_loadu_ps(age + i), step);
+                int alive = _mm_movemask_ps(_mm_cmplt_ps(nage, _mm_loadu_ps(lifetime + i)));
+
+                if (alive == 0xF) {
+                    _mm_storeu_ps(vx + write, nvx); _mm_storeu_ps(vy + write, nvy); _mm_storeu_ps(vz + write, nvz);
+                    _mm_storeu_ps(px + write, npx); _mm_storeu_ps(py + write, npy); _mm_storeu_ps(pz + write, npz);
+                    _mm_storeu_ps(age + write, nage);
+                    if (write != i) {
+                        _mm_storeu_ps(lifetime + write, _mm_loadu_ps(lifetime + i));
+                        _mm_storeu_ps(size + write, _mm_loadu_ps(size + i));
+                        _mm_storeu_si128((__m128i*)(color + write), _mm_loadu_si128((const __m128i*)(color + i)));
+                    }
+                    write += 4;
+                }
+                else if (alive) {
+                    // Some died, survivors go out one by one
+                    alignas(16) float lanes[7][4];
+                    _mm_store_ps(lanes[0], npx); _mm_store_ps(lanes[1], npy); _mm_store_ps(lanes[2], npz);
+                    _mm_store_ps(lanes[3], nvx); _mm_store_ps(lanes[4], nvy); _mm_store_ps(lanes[5], nvz);
+                    _mm_store_ps(lanes[6], nage);
+                    for (int lane = 0; lane < 4; ++lane) {
+                        if (!(alive & (1 << lane)))
+                            continue;
+                        px[write] = lanes[0][lane]; py[write] = lanes[1][lane]; pz[write] = lanes[2][lane];
+                        vx[write] = lanes[3][lane]; vy[write] = lanes[4][lane]; vz[write] = lanes[5][lane];
+                        age[write] = lanes[6][lane];
+                        lifetime[write] = lifetime[i + lane];
+                        size[write] = size[i + lane];
+                        color[write] = color[i + lane];
+                        ++write;
+                    }
+                }
+            }
+        }
+#endif
+        for (; i < end; ++i) {
+            float new_age = age[i] + dt;
+            if (new_age >= lifetime[i])
+                continue;
+            float nvx = (vx[i] + gravity.x) * damping;
+            float nvy = (vy[i] + gravity.y) * damping;
+            float nvz = (vz[i] + gravity.z) * damping;
+            px[write] = px[i] + nvx * dt;
+            py[write] = py[i] + nvy * dt;
+            pz[write] = pz[i] + nvz * dt;
+            vx[write] = nvx;
+            vy[write] = nvy;
+            vz[write] = nvz;
+            age[write] = new_age;
+            lifetime[write] = lifetime[i];
+            size[write] = size[i];
+            color[write] = color[i];
+            ++write;
+        }
+        return write - begin;
+    }
+
+    // Holes below the new count get survivors from above it, highest first
+    size_t fillHoles()
+    {
+        size_t alive = 0;
+        for (const Range &range : ranges)
+            alive += range.alive;
+
+        size_t source_range = ranges.size();
+        size_t source = 0; // one past the next survivor to take
+        auto nextSource = [&]() -> size_t {
+            while (source <= ranges[source_range].begin || source - 1 < alive) {
+                --source_range;
+                source = ranges[source_range].begin + ranges[source_range].alive;
+            }
+            return --source;
+        };
+        if (!ranges.empty()) {
+            source_range = ranges.size() - 1;
+            source = ranges[source_range].begin + ranges[source_range].alive;
+        }
+
+        for (const Range &range : ranges) {
+            size_t hole_end = std::min(range.end, alive);
+            for (size_t hole = range.begin + range.alive; hole < hole_end; ++hole)
+                moveParticle(hole, nextSource());
+        }
+        return alive;
+    }
+
+    // Bigger is further along the view direction, flipped so ascending order is back to front
+    void writeDepthKeys(size_t begin, size_t end, const glm::vec3 &eye, const glm::vec3 &front)
+    {
+        const float* px = stream(POSITION_X); const float* py = stream(POSITION_Y); const float* pz = stream(POSITION_Z);
+        for (size_t i = begin; i < end; ++i) {
+            float depth = (px[i] - eye.x) * front.x + (py[i] - eye.y) * front.y + (pz[i] - eye.z) * front.z;
+            uint32_t bits;
+            memcpy(&bits, &depth, sizeof(bits));
+            bits ^= (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u; // float order as unsigned order
+            keys[i] = ~bits;
+        }
+    }
+
+    // LSD, 8 bits a pass, passes where every key shares the digit are skipped
+    const uint32_t* radixSort()
+    {
+        order.resize(count);
+        scratch_order.resize(count);
+        scratch_keys.resize(count);
+        for (size_t i = 0; i < count; ++i)
+            order[i] = (uint32_t)i;
+
+        uint32_t* keys_in = keys.data();
+        uint32_t* keys_out = scratch_keys.data();
+        uint32_t* order_in = order.data();
+        uint32_t* order_out = scratch_order.data();
+        for (int shift = 0; shift < 32; shift += 8) {
+            size_t offsets[256] = {};
+            for (size_t i = 0; i < count; ++i)
+                ++offsets[(keys_in[i] >> shift) & 0xFF];
+            if (offsets[(keys_in[0] >> shift) & 0xFF] == count)
+                continue;
+
+            size_t sum = 0;
+            for (size_t &offset : offsets) {
+                size_t digit_count = offset;
+                offset = sum;
+                sum += digit_count;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                size_t slot = offsets[(keys_in[i] >> shift) & 0xFF]++;
+                keys_out[slot] = keys_in[i];
+                order_out[slot] = order_in[i];
+            }
+            std::swap(keys_in, keys_out);
+            std::swap(order_in, order_out);
+        }
+        return order_in;
+    }
+
+    // order is nullptr for pool order. Fades out over the last half of the lifetime.
+    void packRange(size_t begin, size_t end, const uint32_t* order)
+    {
+        const float* px = stream(POSITION_X); const float* py = stream(POSITION_Y); const float* pz = stream(POSITION_Z);
+        const float* age = stream(AGE); const float* lifetime = stream(LIFETIME); const float* size = stream(SIZE);
+        const uint32_t* color = colors.get();
+
+        for (size_t i = begin; i < end; ++i) {
+            size_t p = order ? order[i] : i;
+            float fade = std::clamp(2.0f - 2.0f * age[p] / lifetime[p], 0.0f, 1.0f);
+            uint32_t alpha = (uint32_t)((color[p] >> 24) * fade);
+
+            ParticleInstance &instance = instances[i];
+            instance.x = px[p];
+            instance.y = py[p];
+            instance.z = pz[p];
+            instance.size = size[p];
+            instance.color = (color[p] & 0x00FFFFFFu) | (alpha << 24);
+        }
+    }
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <Utils/resource_manager.hpp>
 
 /// @TODO:
 /// Better naming convention required
@@ -14,7 +15,7 @@ namespace Primitives {
 /// 
 /// Planes
 /// 
-unsigned int plane_VBO, plane_VAO, plane_EBO;
+ResourceHandle plane_VBO, plane_VAO, plane_EBO;
 static const float plane_vertices[] = {
 	// positions          // colors           // texture coords
 	 1.0f,  0.0f,  1.0f,   1.0f, 0.0f, 0.0f,   1.0f, 1.0f, // top right
@@ -29,17 +30,13 @@ static const unsigned int plane_indices[] = {
 };
 
 void GenerateVAOPlane() {
-	glGenVertexArrays(1, &plane_VAO);
-	glGenBuffers(1, &plane_VBO);
-	glGenBuffers(1, &plane_EBO);
+	ResourceManager &resources = GetResourceManager();
+	plane_VAO = resources.CreateVertexArray();
+	glBindVertexArray(resources.Get(plane_VAO));
 
-	glBindVertexArray(plane_VAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, plane_VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(plane_vertices), plane_vertices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, plane_EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(plane_indices), plane_indices, GL_STATIC_DRAW);
+	// Buffers get bound on creation, the EBO binding sticks to the VAO
+	plane_VBO = resources.CreateBuffer(GL_ARRAY_BUFFER, sizeof(plane_vertices), plane_vertices, GL_STATIC_DRAW);
+	plane_EBO = resources.CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, sizeof(plane_indices), plane_indices, GL_STATIC_DRAW);
 
 	// position attribute
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
@@ -53,17 +50,17 @@ void GenerateVAOPlane() {
 }
 
 void UseVAOPlane() {
-	if (!plane_VAO) {
+	if (!GetResourceManager().IsAlive(plane_VAO)) {
 		GenerateVAOPlane();
 	}
 
-	glBindVertexArray(plane_VAO);
+	glBindVertexArray(GetResourceManager().Get(plane_VAO));
 }
 
 /// 
 /// Cube
 /// 
-unsigned int cube_VBO, cube_VAO;
+ResourceHandle cube_VBO, cube_VAO;
 static const float cube_vertices[] = {
 	// back face
 	-0.5f, -0.5f, -0.5f, 0.0f, 0.0f, // bottom-left
@@ -110,13 +107,11 @@ static const float cube_vertices[] = {
 };
 
 void GenerateVAOCube() {
-	glGenVertexArrays(1, &cube_VAO);
-	glGenBuffers(1, &cube_VBO);
+	ResourceManager &resources = GetResourceManager();
+	cube_VAO = resources.CreateVertexArray();
+	glBindVertexArray(resources.Get(cube_VAO));
 
-	glBindVertexArray(cube_VAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, cube_VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
+	cube_VBO = resources.CreateBuffer(GL_ARRAY_BUFFER, sizeof(cube_vertices), cube_vertices, GL_STATIC_DRAW);
 
 	// position attribute
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -127,17 +122,17 @@ void GenerateVAOCube() {
 }
 
 void UseVAOCube() {
-	if (!cube_VAO) {
+	if (!GetResourceManager().IsAlive(cube_VAO)) {
 		GenerateVAOCube();
 	}
 
-	glBindVertexArray(cube_VAO);
+	glBindVertexArray(GetResourceManager().Get(cube_VAO));
 }
 
 /// 
 /// Skybox Cube
 ///
-unsigned int skybox_VBO, skybox_VAO;
+ResourceHandle skybox_VBO, skybox_VAO;
 static const float skybox_vertices[] = {
 	// positions          
     -1.0f,  1.0f, -1.0f,
@@ -184,13 +179,11 @@ static const float skybox_vertices[] = {
 };
 
 void GenerateVAOSkybox() {
-	glGenVertexArrays(1, &skybox_VAO);
-	glGenBuffers(1, &skybox_VBO);
-
-	glBindVertexArray(skybox_VAO);
+	ResourceManager &resources = GetResourceManager();
+	skybox_VAO = resources.CreateVertexArray();
+	glBindVertexArray(resources.Get(skybox_VAO));
 
-	glBindBuffer(GL_ARRAY_BUFFER, skybox_VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(skybox_vertices), skybox_vertices, GL_STATIC_DRAW);
+	skybox_VBO = resources.CreateBuffer(GL_ARRAY_BUFFER, sizeof(skybox_vertices), skybox_vertices, GL_STATIC_DRAW);
 
 	// position attribute
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
@@ -198,11 +191,11 @@ void GenerateVAOSkybox() {
 }
 
 void UseVAOSkybox() {
-	if (!skybox_VAO) {
+	if (!GetResourceManager().IsAlive(skybox_VAO)) {
 		GenerateVAOSkybox();
 	}
 
-	glBindVertexArray(skybox_VAO);
+	glBindVertexArray(GetResourceManager().Get(skybox_VAO));
 }
 
 void UnbindVAO() {
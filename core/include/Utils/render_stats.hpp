@@ -0,0 +1,635 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Render statistics
+///
+/// Per frame counters for what the engine asks of GL. Install() swaps glad's
+/// function pointers for the calls we use with counting wrappers that forward
+/// to the driver, so every call site (main.cpp and every header) is counted
+/// without touching it. Call it right after gladLoadGLLoader.
+///
+/// GPU side, where GL 4.6 or GL_ARB_pipeline_statistics_query is available,
+/// pipeline statistics queries count vertices, primitives and shader
+/// invocations. A GL_TIME_ELAPSED query gives GPU time either way. Query
+/// results are read RENDER_STATS_QUERY_FRAMES frames late so nothing waits.
+///
+/// BeginFrame() / EndFrame() bracket the frame. Whatever is drawn after
+/// EndFrame() (the HUD) doesn't count.
+
+struct RenderCounters {
+    uint64_t draw_calls = 0;
+    uint64_t instances = 0;
+    uint64_t vertices = 0;
+    uint64_t triangles = 0;
+    uint64_t program_binds = 0;
+    uint64_t vao_binds = 0;
+    uint64_t texture_binds = 0;
+    uint64_t buffer_binds = 0;
+    uint64_t framebuffer_binds = 0;
+    uint64_t state_changes = 0;   // enable/disable, depth, blend, masks, viewport, clip control
+    uint64_t uniform_uploads = 0;
+    uint64_t buffer_uploads = 0;
+    uint64_t upload_bytes = 0;    // buffers only
+    uint64_t texture_uploads = 0;
+};
+
+struct PipelineCounters {
+    bool valid = false;
+    uint64_t vertices_submitted = 0;
+    uint64_t primitives_submitted = 0;
+    uint64_t vertex_shader_invocations = 0;
+    uint64_t clipping_input_primitives = 0;
+    uint64_t clipping_output_primitives = 0;
+    uint64_t fragment_shader_invocations = 0;
+};
+
+struct FrameTiming {
+    double frame_ms = 0.0; // BeginFrame to BeginFrame, vsync included
+    double cpu_ms = 0.0;   // BeginFrame to EndFrame
+    double gpu_ms = 0.0;   // RENDER_STATS_QUERY_FRAMES late
+};
+
+const int RENDER_STATS_QUERY_FRAMES = 4;
+const int RENDER_STATS_HISTORY = 240;
+
+class RenderStats
+{
+public:
+    RenderCounters Current;       // being counted
+    RenderCounters Last;          // last finished frame
+    PipelineCounters Pipeline;
+    FrameTiming Timing;
+    uint64_t Frame = 0;
+    bool PipelineSupported = false;
+
+    void Install()
+    {
+        wrap(glad_glDrawArrays, realDrawArrays, countedDrawArrays);
+        wrap(glad_glDrawArraysInstanced, realDrawArraysInstanced, countedDrawArraysInstanced);
+        wrap(glad_glDrawArraysInstancedBaseInstance, realDrawArraysInstancedBaseInstance, countedDrawArraysInstancedBaseInstance);
+        wrap(glad_glDrawElements, realDrawElements, countedDrawElements);
+        wrap(glad_glDrawElementsInstancedBaseInstance, realDrawElementsInstancedBaseInstance, countedDrawElementsInstancedBaseInstance);
+        wrap(glad_glMultiDrawArrays, realMultiDrawArrays, countedMultiDrawArrays);
+
+        wrap(glad_glUseProgram, realUseProgram, countedUseProgram);
+        wrap(glad_glBindVertexArray, realBindVertexArray, countedBindVertexArray);
+        wrap(glad_glBindTexture, realBindTexture, countedBindTexture);
+        wrap(glad_glBindBuffer, realBindBuffer, countedBindBuffer);
+        wrap(glad_glBindBufferBase, realBindBufferBase, countedBindBufferBase);
+        wrap(glad_glBindFramebuffer, realBindFramebuffer, countedBindFramebuffer);
+
+        wrap(glad_glEnable, realEnable, countedEnable);
+        wrap(glad_glDisable, realDisable, countedDisable);
+        wrap(glad_glDepthFunc, realDepthFunc, countedDepthFunc);
+        wrap(glad_glDepthMask, realDepthMask, countedDepthMask);
+        wrap(glad_glColorMask, realColorMask, countedColorMask);
+        wrap(glad_glBlendFunc, realBlendFunc, countedBlendFunc);
+        wrap(glad_glViewport, realViewport, countedViewport);
+        wrap(glad_glClipControl, realClipControl, countedClipControl);
+        wrap(glad_glActiveTexture, realActiveTexture, countedActiveTexture);
+
+        wrap(glad_glUniform1i, realUniform1i, countedUniform1i);
+        wrap(glad_glUniform1f, realUniform1f, countedUniform1f);
+        wrap(glad_glUniform2f, realUniform2f, countedUniform2f);
+        wrap(glad_glUniform3f, realUniform3f, countedUniform3f);
+        wrap(glad_glUniform4f, realUniform4f, countedUniform4f);
+        wrap(glad_glUniform2fv, realUniform2fv, countedUniform2fv);
+        wrap(glad_glUniform3fv, realUniform3fv, countedUniform3fv);
+        wrap(glad_glUniform4fv, realUniform4fv, countedUniform4fv);
+        wrap(glad_glUniform1uiv, realUniform1uiv, countedUniform1uiv);
+        wrap(glad_glUniformMatrix2fv, realUniformMatrix2fv, countedUniformMatrix2fv);
+        wrap(glad_glUniformMatrix3fv, realUniformMatrix3fv, countedUniformMatrix3fv);
+        wrap(glad_glUniformMatrix4fv, realUniformMatrix4fv, countedUniformMatrix4fv);
+
+        wrap(glad_glBufferData, realBufferData, countedBufferData);
+        wrap(glad_glBufferSubData, realBufferSubData, countedBufferSubData);
+        wrap(glad_glTexSubImage2D, realTexSubImage2D, countedTexSubImage2D);
+        wrap(glad_glTexSubImage3D, realTexSubImage3D, countedTexSubImage3D);
+
+        PipelineSupported = GLAD_GL_VERSION_4_6 || hasExtension("GL_ARB_pipeline_statistics_query");
+        for (QuerySet &set : query_sets) {
+            glGenQueries(1, &set.time);
+            if (PipelineSupported)
+                glGenQueries(PIPELINE_QUERY_COUNT, set.pipeline);
+        }
+        installed = true;
+    }
+
+    void BeginFrame()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (Frame > 0)
+            Timing.frame_ms = std::chrono::duration<double, std::milli>(now - frame_start).count();
+        frame_start = now;
+        history[Frame % RENDER_STATS_HISTORY] = (float)Timing.frame_ms;
+        ++Frame;
+        Current = RenderCounters();
+
+        if (!installed)
+            return;
+
+        // The set we're about to reuse finished RENDER_STATS_QUERY_FRAMES frames ago
+        QuerySet &set = query_sets[current_set];
+        if (set.pending) {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(set.time, GL_QUERY_RESULT, &nanoseconds);
+            Timing.gpu_ms = (double)nanoseconds / 1e6;
+            if (PipelineSupported) {
+                GLuint64 results[PIPELINE_QUERY_COUNT] = {};
+                for (int i = 0; i < PIPELINE_QUERY_COUNT; ++i)
+                    glGetQueryObjectui64v(set.pipeline[i], GL_QUERY_RESULT, &results[i]);
+                Pipeline.valid = true;
+                Pipeline.vertices_submitted = results[0];
+                Pipeline.primitives_submitted = results[1];
+                Pipeline.vertex_shader_invocations = results[2];
+                Pipeline.clipping_input_primitives = results[3];
+                Pipeline.clipping_output_primitives = results[4];
+                Pipeline.fragment_shader_invocations = results[5];
+            }
+        }
+
+        glBeginQuery(GL_TIME_ELAPSED, set.time);
+        if (PipelineSupported) {
+            for (int i = 0; i < PIPELINE_QUERY_COUNT; ++i)
+                glBeginQuery(PIPELINE_TARGETS[i], set.pipeline[i]);
+        }
+    }
+
+    void EndFrame()
+    {
+        Timing.cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+        Last = Current;
+        if (!installed)
+            return;
+
+        glEndQuery(GL_TIME_ELAPSED);
+        if (PipelineSupported) {
+            for (int i = 0; i < PIPELINE_QUERY_COUNT; ++i)
+                glEndQuery(PIPELINE_TARGETS[i]);
+        }
+        query_sets[current_set].pending = true;
+        current_set = (current_set + 1) % RENDER_STATS_QUERY_FRAMES;
+    }
+
+    // Frame time in ms, age 0 is the newest
+    float FrameTime(int age) const
+    {
+        if (age < 0 || (uint64_t)age >= Frame || age >= RENDER_STATS_HISTORY)
+            return 0.0f;
+        return history[(Frame - 1 - age) % RENDER_STATS_HISTORY];
+    }
+
+    // Name and value of everything above, the order CSV columns come in
+    std::vector<std::pair<const char*, double>> Fields() const
+    {
+        return {
+            { "frame", (double)Frame },
+            { "frame_ms", Timing.frame_ms },
+            { "cpu_ms", Timing.cpu_ms },
+            { "gpu_ms", Timing.gpu_ms },
+            { "draw_calls", (double)Last.draw_calls },
+            { "instances", (double)Last.instances },
+            { "vertices", (double)Last.vertices },
+            { "triangles", (double)Last.triangles },
+            { "program_binds", (double)Last.program_binds },
+            { "vao_binds", (double)Last.vao_binds },
+            { "texture_binds", (double)Last.texture_binds },
+            { "buffer_binds", (double)Last.buffer_binds },
+            { "framebuffer_binds", (double)Last.framebuffer_binds },
+            { "state_changes", (double)Last.state_changes },
+            { "uniform_uploads", (double)Last.uniform_uploads },
+            { "buffer_uploads", (double)Last.buffer_uploads },
+            { "upload_bytes", (double)Last.upload_bytes },
+            { "texture_uploads", (double)Last.texture_uploads },
+            { "gpu_vertices_submitted", (double)Pipeline.vertices_submitted },
+            { "gpu_primitives_submitted", (double)Pipeline.primitives_submitted },
+            { "gpu_vertex_shader_invocations", (double)Pipeline.vertex_shader_invocations },
+            { "gpu_clipping_input_primitives", (double)Pipeline.clipping_input_primitives },
+            { "gpu_clipping_output_primitives", (double)Pipeline.clipping_output_primitives },
+            { "gpu_fragment_shader_invocations", (double)Pipeline.fragment_shader_invocations },
+        };
+    }
+
+    void Release()
+    {
+        if (!installed)
+            return;
+        for (QuerySet &set : query_sets) {
+            glDeleteQueries(1, &set.time);
+            if (PipelineSupported)
+                glDeleteQueries(PIPELINE_QUERY_COUNT, set.pipeline);
+            set = QuerySet();
+        }
+    }
+
+private:
+    static constexpr int PIPELINE_QUERY_COUNT = 6;
+    static constexpr GLenum PIPELINE_TARGETS[PIPELINE_QUERY_COUNT] = {
+        GL_VERTICES_SUBMITTED,
+        GL_PRIMITIVES_SUBMITTED,
+        GL_VERTEX_SHADER_INVOCATIONS,
+        GL_CLIPPING_INPUT_PRIMITIVES,
+        GL_CLIPPING_OUTPUT_PRIMITIVES,
+        GL_FRAGMENT_SHADER_INVOCATIONS
+    };
+
+    struct QuerySet {
+        GLuint time = 0;
+        GLuint pipeline[PIPELINE_QUERY_COUNT] = {};
+        bool pending = false;
+    };
+
+    bool installed = false;
+    QuerySet query_sets[RENDER_STATS_QUERY_FRAMES];
+    int current_set = 0;
+    std::chrono::steady_clock::time_point frame_start;
+    float history[RENDER_STATS_HISTORY] = {};
+
+    template<typename Function>
+    static void wrap(Function &glad_pointer, Function &real, Function counted)
+    {
+        // Missing entry points stay missing
+        if (!glad_pointer || glad_pointer == counted)
+            return;
+        real = glad_pointer;
+        glad_pointer = counted;
+    }
+
+    static bool hasExtension(const char* name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (extension && strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    static RenderCounters& counters();
+
+    static uint64_t trianglesOf(GLenum mode, GLsizei count)
+    {
+        switch (mode) {
+        case GL_TRIANGLES:      return (uint64_t)count / 3;
+        case GL_TRIANGLE_STRIP:
+        case GL_TRIANGLE_FAN:   return count > 2 ? (uint64_t)count - 2 : 0;
+        default:                return 0;
+        }
+    }
+
+    static void countDraw(GLenum mode, GLsizei count, GLsizei instances)
+    {
+        RenderCounters &c = counters();
+        ++c.draw_calls;
+        c.instances += (uint64_t)instances;
+        c.vertices += (uint64_t)count * (uint64_t)instances;
+        c.triangles += trianglesOf(mode, count) * (uint64_t)instances;
+    }
+
+    ///
+    /// Wrappers, count then forward
+    ///
+    static inline PFNGLDRAWARRAYSPROC realDrawArrays = nullptr;
+    static void APIENTRY countedDrawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        countDraw(mode, count, 1);
+        realDrawArrays(mode, first, count);
+    }
+
+    static inline PFNGLDRAWARRAYSINSTANCEDPROC realDrawArraysInstanced = nullptr;
+    static void APIENTRY countedDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instancecount)
+    {
+        countDraw(mode, count, instancecount);
+        realDrawArraysInstanced(mode, first, count, instancecount);
+    }
+
+    static inline PFNGLDRAWARRAYSINSTANCEDBASEINSTANCEPROC realDrawArraysInstancedBaseInstance = nullptr;
+    static void APIENTRY countedDrawArraysInstancedBaseInstance(GLenum mode, GLint first, GLsizei count, GLsizei instancecount, GLuint baseinstance)
+    {
+        countDraw(mode, count, instancecount);
+        realDrawArraysInstancedBaseInstance(mode, first, count, instancecount, baseinstance);
+    }
+
+    static inline PFNGLDRAWELEMENTSPROC realDrawElements = nullptr;
+    static void APIENTRY countedDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+    {
+        countDraw(mode, count, 1);
+        realDrawElements(mode, count, type, indices);
+    }
+
+    static inline PFNGLDRAWELEMENTSINSTANCEDBASEINSTANCEPROC realDrawElementsInstancedBaseInstance = nullptr;
+    static void APIENTRY countedDrawElementsInstancedBaseInstance(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instancecount, GLuint baseinstance)
+    {
+        countDraw(mode, count, instancecount);
+        realDrawElementsInstancedBaseInstance(mode, count, type, indices, instancecount, baseinstance);
+    }
+
+    // One call, but the driver sees drawcount draws
+    static inline PFNGLMULTIDRAWARRAYSPROC realMultiDrawArrays = nullptr;
+    static void APIENTRY countedMultiDrawArrays(GLenum mode, const GLint* first, const GLsizei* count, GLsizei drawcount)
+    {
+        for (GLsizei i = 0; i < drawcount; ++i)
+            countDraw(mode, count[i], 1);
+        realMultiDrawArrays(mode, first, count, drawcount);
+    }
+
+    static inline PFNGLUSEPROGRAMPROC realUseProgram = nullptr;
+    static void APIENTRY countedUseProgram(GLuint program)
+    {
+        ++counters().program_binds;
+        realUseProgram(program);
+    }
+
+    static inline PFNGLBINDVERTEXARRAYPROC realBindVertexArray = nullptr;
+    static void APIENTRY countedBindVertexArray(GLuint array)
+    {
+        ++counters().vao_binds;
+        realBindVertexArray(array);
+    }
+
+    static inline PFNGLBINDTEXTUREPROC realBindTexture = nullptr;
+    static void APIENTRY countedBindTexture(GLenum target, GLuint texture)
+    {
+        ++counters().texture_binds;
+        realBindTexture(target, texture);
+    }
+
+    static inline PFNGLBINDBUFFERPROC realBindBuffer = nullptr;
+    static void APIENTRY countedBindBuffer(GLenum target, GLuint buffer)
+    {
+        ++counters().buffer_binds;
+        realBindBuffer(target, buffer);
+    }
+
+    static inline PFNGLBINDBUFFERBASEPROC realBindBufferBase = nullptr;
+    static void APIENTRY countedBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+    {
+        ++counters().buffer_binds;
+        realBindBufferBase(target, index, buffer);
+    }
+
+    static inline PFNGLBINDFRAMEBUFFERPROC realBindFramebuffer = nullptr;
+    static void APIENTRY countedBindFramebuffer(GLenum target, GLuint framebuffer)
+    {
+        ++counters().framebuffer_binds;
+        realBindFramebuffer(target, framebuffer);
+    }
+
+    static inline PFNGLENABLEPROC realEnable = nullptr;
+    static void APIENTRY countedEnable(GLenum cap)
+    {
+        ++counters().state_changes;
+        realEnable(cap);
+    }
+
+    static inline PFNGLDISABLEPROC realDisable = nullptr;
+    static void APIENTRY countedDisable(GLenum cap)
+    {
+        ++counters().state_changes;
+        realDisable(cap);
+    }
+
+    static inline PFNGLDEPTHFUNCPROC realDepthFunc = nullptr;
+    static void APIENTRY countedDepthFunc(GLenum func)
+    {
+        ++counters().state_changes;
+        realDepthFunc(func);
+    }
+
+    static inline PFNGLDEPTHMASKPROC realDepthMask = nullptr;
+    static void APIENTRY countedDepthMask(GLboolean flag)
+    {
+        ++counters().state_changes;
+        realDepthMask(flag);
+    }
+
+    static inline PFNGLCOLORMASKPROC realColorMask = nullptr;
+    static void APIENTRY countedColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+    {
+        ++counters().state_changes;
+        realColorMask(red, green, blue, alpha);
+    }
+
+    static inline PFNGLBLENDFUNCPROC realBlendFunc = nullptr;
+    static void APIENTRY countedBlendFunc(GLenum sfactor, GLenum dfactor)
+    {
+        ++counters().state_changes;
+        realBlendFunc(sfactor, dfactor);
+    }
+
+    static inline PFNGLVIEWPORTPROC realViewport = nullptr;
+    static void APIENTRY countedViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+    {
+        ++counters().state_changes;
+        realViewport(x, y, width, height);
+    }
+
+    static inline PFNGLCLIPCONTROLPROC realClipControl = nullptr;
+    static void APIENTRY countedClipControl(GLenum origin, GLenum depth)
+    {
+        ++counters().state_changes;
+        realClipControl(origin, depth);
+    }
+
+    static inline PFNGLACTIVETEXTUREPROC realActiveTexture = nullptr;
+    static void APIENTRY countedActiveTexture(GLenum texture)
+    {
+        ++counters().state_changes;
+        realActiveTexture(texture);
+    }
+
+    static inline PFNGLUNIFORM1IPROC realUniform1i = nullptr;
+    static void APIENTRY countedUniform1i(GLint location, GLint v0)
+    {
+        ++counters().uniform_uploads;
+        realUniform1i(location, v0);
+    }
+
+    static inline PFNGLUNIFORM1FPROC realUniform1f = nullptr;
+    static void APIENTRY countedUniform1f(GLint location, GLfloat v0)
+    {
+        ++counters().uniform_uploads;
+        realUniform1f(location, v0);
+    }
+
+    static inline PFNGLUNIFORM2FPROC realUniform2f = nullptr;
+    static void APIENTRY countedUniform2f(GLint location, GLfloat v0, GLfloat v1)
+    {
+        ++counters().uniform_uploads;
+        realUniform2f(location, v0, v1);
+    }
+
+    static inline PFNGLUNIFORM3FPROC realUniform3f = nullptr;
+    static void APIENTRY countedUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+    {
+        ++counters().uniform_uploads;
+        realUniform3f(location, v0, v1, v2);
+    }
+
+    static inline PFNGLUNIFORM4FPROC realUniform4f = nullptr;
+    static void APIENTRY countedUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3)
+    {
+        ++counters().uniform_uploads;
+        realUniform4f(location, v0, v1, v2, v3);
+    }
+
+    static inline PFNGLUNIFORM2FVPROC realUniform2fv = nullptr;
+    static void APIENTRY countedUniform2fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        ++counters().uniform_uploads;
+        realUniform2fv(location, count, value);
+    }
+
+    static inline PFNGLUNIFORM3FVPROC realUniform3fv = nullptr;
+    static void APIENTRY countedUniform3fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        ++counters().uniform_uploads;
+        realUniform3fv(location, count, value);
+    }
+
+    static inline PFNGLUNIFORM4FVPROC realUniform4fv = nullptr;
+    static void APIENTRY countedUniform4fv(GLint location, GLsizei count, const GLfloat* value)
+    {
+        ++counters().uniform_uploads;
+        realUniform4fv(location, count, value);
+    }
+
+    static inline PFNGLUNIFORM1UIVPROC realUniform1uiv = nullptr;
+    static void APIENTRY countedUniform1uiv(GLint location, GLsizei count, const GLuint* value)
+    {
+        ++counters().uniform_uploads;
+        realUniform1uiv(location, count, value);
+    }
+
+    static inline PFNGLUNIFORMMATRIX2FVPROC realUniformMatrix2fv = nullptr;
+    static void APIENTRY countedUniformMatrix2fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        ++counters().uniform_uploads;
+        realUniformMatrix2fv(location, count, transpose, value);
+    }
+
+    static inline PFNGLUNIFORMMATRIX3FVPROC realUniformMatrix3fv = nullptr;
+    static void APIENTRY countedUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        ++counters().uniform_uploads;
+        realUniformMatrix3fv(location, count, transpose, value);
+    }
+
+    static inline PFNGLUNIFORMMATRIX4FVPROC realUniformMatrix4fv = nullptr;
+    static void APIENTRY countedUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        ++counters().uniform_uploads;
+        realUniformMatrix4fv(location, count, transpose, value);
+    }
+
+    static inline PFNGLBUFFERDATAPROC realBufferData = nullptr;
+    static void APIENTRY countedBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        RenderCounters &c = counters();
+        ++c.buffer_uploads;
+        if (data)
+            c.upload_bytes += (uint64_t)size;
+        realBufferData(target, size, data, usage);
+    }
+
+    static inline PFNGLBUFFERSUBDATAPROC realBufferSubData = nullptr;
+    static void APIENTRY countedBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        RenderCounters &c = counters();
+        ++c.buffer_uploads;
+        c.upload_bytes += (uint64_t)size;
+        realBufferSubData(target, offset, size, data);
+    }
+
+    static inline PFNGLTEXSUBIMAGE2DPROC realTexSubImage2D = nullptr;
+    static void APIENTRY countedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+    {
+        ++counters().texture_uploads;
+        realTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+    }
+
+    static inline PFNGLTEXSUBIMAGE3DPROC realTexSubImage3D = nullptr;
+    static void APIENTRY countedTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels)
+    {
+        ++counters().texture_uploads;
+        realTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+    }
+};
+
+// The GL wrappers are plain function pointers, this is how they find the counters
+inline RenderStats& GetRenderStats()
+{
+    static RenderStats stats;
+    return stats;
+}
+
+inline RenderCounters& RenderStats::counters()
+{
+    return GetRenderStats().Current;
+}
+
+/// Render stats stream
+///
+/// One line per frame for CI to trend: CSV (header first) when the path ends
+/// in .csv, JSON Lines (one object per line) otherwise.
+class RenderStatsStream
+{
+public:
+    bool Open(const std::string &path)
+    {
+        csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+        out.open(path);
+        out << std::setprecision(12); // counters in the millions stay whole numbers
+        header_written = false;
+        return (bool)out;
+    }
+
+    bool IsOpen() const { return out.is_open(); }
+
+    void Write(const RenderStats &stats)
+    {
+        if (!out)
+            return;
+
+        std::vector<std::pair<const char*, double>> fields = stats.Fields();
+        if (csv) {
+            if (!header_written) {
+                for (size_t i = 0; i < fields.size(); ++i)
+                    out << (i ? "," : "") << fields[i].first;
+                out << "\n";
+                header_written = true;
+            }
+            for (size_t i = 0; i < fields.size(); ++i)
+                out << (i ? "," : "") << fields[i].second;
+            out << "\n";
+        } else {
+            out << "{";
+            for (size_t i = 0; i < fields.size(); ++i)
+                out << (i ? ", " : "") << "\"" << fields[i].first << "\": " << fields[i].second;
+            out << "}\n";
+        }
+    }
+
+    void Close()
+    {
+        if (out.is_open())
+            out.close();
+    }
+
+private:
+    std::ofstream out;
+    bool csv = false;
+    bool header_written = false;
+};
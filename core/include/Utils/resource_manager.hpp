@@ -0,0 +1,487 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// GPU resource manager
+///
+/// Every texture, buffer, vertex array, framebuffer and program goes through
+/// here instead of raw glGen* calls, so we know what is alive and how many
+/// bytes it takes.
+///
+/// - Handles are (index, generation) pairs. A released slot bumps its generation,
+///   so stale handles resolve to 0 instead of someone else's object.
+/// - Handles are reference counted, Create* returns with one reference.
+/// - Textures created with a loader can be evicted when over the texture budget.
+///   Cold textures (least recently used first) lose their top mip level first,
+///   only once they are down to a single level are they dropped entirely.
+///   Get() brings them back at full resolution through the loader.
+/// - Textures without a loader are pinned, they count towards the budget but
+///   are never touched.
+
+enum Resource_Category {
+    RESOURCE_TEXTURE,
+    RESOURCE_BUFFER,
+    RESOURCE_PROGRAM,
+    RESOURCE_VERTEX_ARRAY,
+    RESOURCE_FRAMEBUFFER,
+    RESOURCE_CATEGORY_COUNT
+};
+
+struct ResourceHandle {
+    uint32_t index = 0;
+    uint32_t generation = 0; // 0 is never a live generation
+
+    bool IsValid() const { return generation != 0; }
+};
+
+// Immutable texture storage. depth is the layer count for arrays, 1 otherwise.
+struct TextureDesc {
+    GLenum target = GL_TEXTURE_2D;
+    GLenum internal_format = GL_RGBA8;
+    int width = 1;
+    int height = 1;
+    int depth = 1;
+    int levels = 1;
+};
+
+// Fills a freshly allocated texture (bound to desc.target) with every level,
+// including sampler parameters. Called on creation and on every reload.
+typedef std::function<bool(GLuint texture, const TextureDesc &desc)> TextureLoader;
+
+struct ResourceStats {
+    uint32_t count[RESOURCE_CATEGORY_COUNT] = {};
+    size_t bytes[RESOURCE_CATEGORY_COUNT] = {};
+
+    // Textures only
+    uint32_t resident_textures = 0;
+    uint32_t degraded_textures = 0; // resident, but missing top mips
+    uint32_t evicted_textures = 0;
+    size_t resident_texture_bytes = 0;
+    size_t evicted_texture_bytes = 0; // what the evicted ones take at full size
+    size_t texture_budget = 0;
+    uint32_t reloads = 0;
+};
+
+// Textures used within this many frames are never evicted
+const uint64_t EVICTION_COLD_FRAMES = 120;
+// Mip dropping stops at this size, below that a texture is evicted outright
+const int EVICTION_MIN_SIZE = 16;
+
+class ResourceManager
+{
+public:
+    ResourceHandle CreateTexture(const TextureDesc &desc, TextureLoader loader = nullptr)
+    {
+        ResourceHandle handle = allocate(RESOURCE_TEXTURE);
+        Slot &slot = slots[handle.index];
+        slot.desc = desc;
+        slot.loader = loader;
+        slot.id = allocateTexture(desc, 0);
+        slot.bytes = textureBytes(desc, 0);
+        if (slot.loader && !slot.loader(slot.id, desc)) {
+            // Keep the storage around, a broken texture is better than a dangling handle
+            slot.loader = nullptr;
+        }
+        return handle;
+    }
+
+    // Makes a pinned texture evictable once its contents can be rebuilt
+    void SetTextureLoader(ResourceHandle handle, TextureLoader loader)
+    {
+        if (Slot* slot = resolve(handle))
+            slot->loader = loader;
+    }
+
+    ResourceHandle CreateBuffer(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        ResourceHandle handle = allocate(RESOURCE_BUFFER);
+        glGenBuffers(1, &slots[handle.index].id);
+        if (size > 0)
+            BufferData(handle, target, size, data, usage);
+        return handle;
+    }
+
+    // glBufferData that keeps the byte count up to date
+    void BufferData(ResourceHandle handle, GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        Slot* slot = resolve(handle);
+        if (!slot)
+            return;
+        glBindBuffer(target, slot->id);
+        glBufferData(target, size, data, usage);
+        slot->bytes = (size_t)size;
+    }
+
+    // glBufferStorage, immutable size, e.g. for persistently mapped buffers
+    void BufferStorage(ResourceHandle handle, GLenum target, GLsizeiptr size, const void* data, GLbitfield flags)
+    {
+        Slot* slot = resolve(handle);
+        if (!slot)
+            return;
+        glBindBuffer(target, slot->id);
+        glBufferStorage(target, size, data, flags);
+        slot->bytes = (size_t)size;
+    }
+
+    ResourceHandle CreateVertexArray()
+    {
+        ResourceHandle handle = allocate(RESOURCE_VERTEX_ARRAY);
+        glGenVertexArrays(1, &slots[handle.index].id);
+        return handle;
+    }
+
+    ResourceHandle CreateFramebuffer()
+    {
+        ResourceHandle handle = allocate(RESOURCE_FRAMEBUFFER);
+        glGenFramebuffers(1, &slots[handle.index].id);
+        return handle;
+    }
+
+    // Takes ownership of an already linked program (e.g. Shader::ID)
+    ResourceHandle AdoptProgram(GLuint program)
+    {
+        ResourceHandle handle = allocate(RESOURCE_PROGRAM);
+        Slot &slot = slots[handle.index];
+        slot.id = program;
+
+        // Closest thing to a size the driver will tell us
+        GLint binary_length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_length);
+        slot.bytes = (size_t)binary_length;
+        return handle;
+    }
+
+    // Returns the GL name, 0 for stale handles. Marks the resource as used this
+    // frame, evicted or degraded textures are reloaded at full resolution.
+    GLuint Get(ResourceHandle handle)
+    {
+        Slot* slot = resolve(handle);
+        if (!slot)
+            return 0;
+
+        slot->last_used = frame;
+        if (slot->category == RESOURCE_TEXTURE && (slot->evicted || slot->dropped_levels > 0))
+            reload(*slot);
+        return slot->id;
+    }
+
+    bool IsAlive(ResourceHandle handle) const
+    {
+        return handle.index < slots.size() && handle.IsValid() && slots[handle.index].generation == handle.generation;
+    }
+
+    void AddRef(ResourceHandle handle)
+    {
+        if (Slot* slot = resolve(handle))
+            ++slot->ref_count;
+    }
+
+    // Drops a reference, the GL object is deleted with the last one
+    void Release(ResourceHandle handle)
+    {
+        Slot* slot = resolve(handle);
+        if (!slot || --slot->ref_count > 0)
+            return;
+
+        destroy(*slot);
+        free_slots.push_back(handle.index);
+    }
+
+    // Deletes everything regardless of references, for shutdown
+    void ReleaseAll()
+    {
+        for (uint32_t i = 0; i < slots.size(); ++i) {
+            if (slots[i].ref_count > 0) {
+                destroy(slots[i]);
+                free_slots.push_back(i);
+            }
+        }
+    }
+
+    // 0 means unlimited
+    void SetTextureBudget(size_t bytes)
+    {
+        texture_budget = bytes;
+    }
+
+    // Call once per frame before drawing, evicts cold textures while over budget
+    void BeginFrame()
+    {
+        ++frame;
+        if (texture_budget == 0)
+            return;
+
+        size_t resident = residentTextureBytes();
+        while (resident > texture_budget) {
+            Slot* victim = coldestTexture();
+            if (!victim)
+                break; // Everything left is hot or pinned
+
+            resident -= victim->bytes;
+            if (canDropLevel(*victim))
+                dropTopLevel(*victim);
+            else
+                evict(*victim);
+            resident += victim->bytes;
+        }
+    }
+
+    ResourceStats Query() const
+    {
+        ResourceStats stats;
+        stats.texture_budget = texture_budget;
+        stats.reloads = reload_count;
+
+        for (const Slot &slot : slots) {
+            if (slot.ref_count <= 0)
+                continue;
+
+            ++stats.count[slot.category];
+            stats.bytes[slot.category] += slot.bytes;
+
+            if (slot.category != RESOURCE_TEXTURE)
+                continue;
+            if (slot.evicted) {
+                ++stats.evicted_textures;
+                stats.evicted_texture_bytes += textureBytes(slot.desc, 0);
+            }
+            else {
+                ++stats.resident_textures;
+                stats.resident_texture_bytes += slot.bytes;
+                if (slot.dropped_levels > 0)
+                    ++stats.degraded_textures;
+            }
+        }
+        return stats;
+    }
+
+private:
+    struct Slot {
+        uint32_t generation = 0;
+        int ref_count = 0;
+        Resource_Category category = RESOURCE_BUFFER;
+        GLuint id = 0;
+        size_t bytes = 0;
+
+        // Textures only
+        TextureDesc desc;
+        TextureLoader loader;
+        uint64_t last_used = 0;
+        int dropped_levels = 0;
+        bool evicted = false;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    uint64_t frame = 0;
+    size_t texture_budget = 0;
+    uint32_t reload_count = 0;
+
+    ResourceHandle allocate(Resource_Category category)
+    {
+        uint32_t index;
+        if (!free_slots.empty()) {
+            index = free_slots.back();
+            free_slots.pop_back();
+        }
+        else {
+            index = (uint32_t)slots.size();
+            slots.emplace_back();
+        }
+
+        Slot &slot = slots[index];
+        uint32_t generation = slot.generation + 1;
+        slot = Slot();
+        slot.generation = generation == 0 ? 1 : generation;
+        slot.ref_count = 1;
+        slot.category = category;
+        slot.last_used = frame;
+        return { index, slot.generation };
+    }
+
+    Slot* resolve(ResourceHandle handle)
+    {
+        if (!IsAlive(handle) || slots[handle.index].ref_count <= 0)
+            return nullptr;
+        return &slots[handle.index];
+    }
+
+    void destroy(Slot &slot)
+    {
+        switch (slot.category) {
+        case RESOURCE_TEXTURE:      glDeleteTextures(1, &slot.id); break;
+        case RESOURCE_BUFFER:       glDeleteBuffers(1, &slot.id); break;
+        case RESOURCE_PROGRAM:      glDeleteProgram(slot.id); break;
+        case RESOURCE_VERTEX_ARRAY: glDeleteVertexArrays(1, &slot.id); break;
+        case RESOURCE_FRAMEBUFFER:  glDeleteFramebuffers(1, &slot.id); break;
+        default: break;
+        }
+
+        // Bump now so outstanding handles die immediately
+        uint32_t generation = slot.generation + 1;
+        slot = Slot();
+        slot.generation = generation == 0 ? 1 : generation;
+    }
+
+    ///
+    /// Textures
+    ///
+    static GLuint allocateTexture(const TextureDesc &desc, int dropped_levels)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(desc.target, texture);
+
+        int width = levelSize(desc.width, dropped_levels);
+        int height = levelSize(desc.height, dropped_levels);
+        int levels = desc.levels - dropped_levels;
+        if (desc.target == GL_TEXTURE_2D_ARRAY || desc.target == GL_TEXTURE_3D)
+            glTexStorage3D(desc.target, levels, desc.internal_format, width, height, desc.target == GL_TEXTURE_3D ? levelSize(desc.depth, dropped_levels) : desc.depth);
+        else
+            glTexStorage2D(desc.target, levels, desc.internal_format, width, height);
+        return texture;
+    }
+
+    static int levelSize(int size, int level)
+    {
+        size >>= level;
+        return size > 0 ? size : 1;
+    }
+
+    static size_t bytesPerTexel(GLenum internal_format)
+    {
+        switch (internal_format) {
+        case GL_R8:                 return 1;
+        case GL_RG8:                return 2;
+        case GL_RGB8:
+        case GL_SRGB8:              return 3;
+        case GL_RGBA16F:            return 8;
+        case GL_RGBA32F:            return 16;
+        case GL_DEPTH_COMPONENT24:
+        case GL_DEPTH_COMPONENT32F:
+        case GL_R32F:
+        case GL_RGBA8:
+        case GL_SRGB8_ALPHA8:
+        default:                    return 4;
+        }
+    }
+
+    static size_t textureBytes(const TextureDesc &desc, int dropped_levels)
+    {
+        size_t layers = desc.target == GL_TEXTURE_CUBE_MAP ? 6 : (size_t)desc.depth;
+        size_t bytes = 0;
+        for (int level = dropped_levels; level < desc.levels; ++level) {
+            size_t depth = desc.target == GL_TEXTURE_3D ? (size_t)levelSize(desc.depth, level) : layers;
+            bytes += (size_t)levelSize(desc.width, level) * levelSize(desc.height, level) * depth;
+        }
+        return bytes * bytesPerTexel(desc.internal_format);
+    }
+
+    size_t residentTextureBytes() const
+    {
+        size_t bytes = 0;
+        for (const Slot &slot : slots) {
+            if (slot.ref_count > 0 && slot.category == RESOURCE_TEXTURE)
+                bytes += slot.bytes;
+        }
+        return bytes;
+    }
+
+    Slot* coldestTexture()
+    {
+        Slot* coldest = nullptr;
+        for (Slot &slot : slots) {
+            if (slot.ref_count <= 0 || slot.category != RESOURCE_TEXTURE || !slot.loader || slot.evicted)
+                continue;
+            if (frame - slot.last_used < EVICTION_COLD_FRAMES)
+                continue;
+            if (!coldest || slot.last_used < coldest->last_used)
+                coldest = &slot;
+        }
+        return coldest;
+    }
+
+    static bool canDropLevel(const Slot &slot)
+    {
+        int next = slot.dropped_levels + 1;
+        return next < slot.desc.levels
+            && levelSize(slot.desc.width, next) >= EVICTION_MIN_SIZE
+            && levelSize(slot.desc.height, next) >= EVICTION_MIN_SIZE;
+    }
+
+    // Reallocates one level smaller and copies the remaining levels over
+    void dropTopLevel(Slot &slot)
+    {
+        int dropped = slot.dropped_levels + 1;
+        GLuint smaller = allocateTexture(slot.desc, dropped);
+        copyParameters(slot.desc.target, slot.id, smaller);
+
+        int layers = slot.desc.target == GL_TEXTURE_CUBE_MAP ? 6 : slot.desc.depth;
+        for (int level = dropped; level < slot.desc.levels; ++level) {
+            int depth = slot.desc.target == GL_TEXTURE_3D ? levelSize(slot.desc.depth, level) : layers;
+            glCopyImageSubData(
+                slot.id, slot.desc.target, level, 0, 0, 0,
+                smaller, slot.desc.target, level - dropped, 0, 0, 0,
+                levelSize(slot.desc.width, level), levelSize(slot.desc.height, level), depth
+            );
+        }
+
+        glDeleteTextures(1, &slot.id);
+        slot.id = smaller;
+        slot.dropped_levels = dropped;
+        slot.bytes = textureBytes(slot.desc, dropped);
+    }
+
+    void evict(Slot &slot)
+    {
+        glDeleteTextures(1, &slot.id);
+        slot.id = 0;
+        slot.bytes = 0;
+        slot.evicted = true;
+    }
+
+    void reload(Slot &slot)
+    {
+        GLuint texture = allocateTexture(slot.desc, 0);
+        if (!slot.loader(texture, slot.desc)) {
+            // Keep whatever we still have rather than an empty texture
+            glDeleteTextures(1, &texture);
+            return;
+        }
+
+        if (slot.id)
+            glDeleteTextures(1, &slot.id);
+        slot.id = texture;
+        slot.bytes = textureBytes(slot.desc, 0);
+        slot.dropped_levels = 0;
+        slot.evicted = false;
+        ++reload_count;
+    }
+
+    static void copyParameters(GLenum target, GLuint from, GLuint to)
+    {
+        static const GLenum params[] = {
+            GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER,
+            GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R
+        };
+
+        for (GLenum param : params) {
+            GLint value;
+            glBindTexture(target, from);
+            glGetTexParameteriv(target, param, &value);
+            glBindTexture(target, to);
+            glTexParameteri(target, param, value);
+        }
+    }
+};
+
+inline ResourceManager& GetResourceManager()
+{
+    static ResourceManager manager;
+    return manager;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <Utils/resource_manager.hpp>
+
+#include <cmath>
+#include <iostream>
+
+/// Scene target
+///
+/// The scene is drawn into an offscreen framebuffer (RGBA8 color, 32 bit float
+/// depth) and blitted to the window at the end of the frame, the default
+/// framebuffer only offers fixed point depth.
+///
+/// DEPTH_REVERSED maps the near plane to 1 and infinity to 0, with
+/// glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE). Float depth has most of its
+/// precision close to 0, reversing puts it where perspective has the least,
+/// so depth stays usable from NEAR_PLANE out to the horizon and there is no far
+/// plane to clip against. DEPTH_STANDARD is the usual -1 to 1 mapping with a
+/// far plane, kept around to compare.
+///
+/// Anything that picks a depth func or a far depth should ask the target
+/// (Less(), LessEqual(), FarDepth()) instead of hard coding GL_LESS and 1.0.
+
+enum Depth_Mode {
+    DEPTH_STANDARD,
+    DEPTH_REVERSED
+};
+
+class SceneTarget
+{
+public:
+    Depth_Mode Mode = DEPTH_REVERSED;
+
+    void Init(int width, int height)
+    {
+        FBO = GetResourceManager().CreateFramebuffer();
+        Resize(width, height);
+    }
+
+    // Reallocates the attachments, call on window resize
+    void Resize(int width, int height)
+    {
+        ResourceManager &resources = GetResourceManager();
+        resources.Release(color);
+        resources.Release(depth);
+
+        this->width = width > 0 ? width : 1;
+        this->height = height > 0 ? height : 1;
+
+        TextureDesc desc;
+        desc.width = this->width;
+        desc.height = this->height;
+        desc.internal_format = GL_RGBA8;
+        color = resources.CreateTexture(desc);
+        desc.internal_format = GL_DEPTH_COMPONENT32F;
+        depth = resources.CreateTexture(desc);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, resources.Get(FBO));
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resources.Get(color), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, resources.Get(depth), 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::SCENE_TARGET::FRAMEBUFFER_INCOMPLETE" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // Binds and clears the target, sets up clip control and the depth func for Mode
+    void Begin(const glm::vec4 &clear_color)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, GetResourceManager().Get(FBO));
+        glViewport(0, 0, width, height);
+
+        glClipControl(GL_LOWER_LEFT, Mode == DEPTH_REVERSED ? GL_ZERO_TO_ONE : GL_NEGATIVE_ONE_TO_ONE);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(Less());
+        glClearDepth(FarDepth());
+        glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
+        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    }
+
+    // Copies the color to the window, leaves the default framebuffer bound
+    void Resolve()
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, GetResourceManager().Get(FBO));
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // glm::perspective for DEPTH_STANDARD, an infinite reversed one otherwise (far_plane unused)
+    glm::mat4 Projection(float fovy, float aspect, float near_plane, float far_plane) const
+    {
+        if (Mode == DEPTH_STANDARD)
+            return glm::perspective(fovy, aspect, near_plane, far_plane);
+
+        // Clip z is the near plane, w is view depth, so NDC z = near / depth
+        float focal = 1.0f / std::tan(fovy * 0.5f);
+        glm::mat4 projection(0.0f);
+        projection[0][0] = focal / aspect;
+        projection[1][1] = focal;
+        projection[2][3] = -1.0f;
+        projection[3][2] = near_plane;
+        return projection;
+    }
+
+    GLenum Less() const { return Mode == DEPTH_REVERSED ? GL_GREATER : GL_LESS; }
+    GLenum LessEqual() const { return Mode == DEPTH_REVERSED ? GL_GEQUAL : GL_LEQUAL; }
+    float FarDepth() const { return Mode == DEPTH_REVERSED ? 0.0f : 1.0f; }
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    void Release()
+    {
+        ResourceManager &resources = GetResourceManager();
+        resources.Release(FBO);
+        resources.Release(color);
+        resources.Release(depth);
+        FBO = color = depth = ResourceHandle();
+    }
+
+private:
+    ResourceHandle FBO;
+    ResourceHandle color;
+    ResourceHandle depth;
+    int width = 1;
+    int height = 1;
+};
@@ -2,10 +2,9 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <Utils/vfs.hpp>
 
 #include <string>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 
 class Shader
@@ -19,48 +18,22 @@ public:
     }
 
     // constructor generates the shader on the fly
+    // defines (e.g. "#define FOO\n") are inserted right after each #version line
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr, const char* defines = nullptr)
     {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
+        // 1. retrieve the vertex/fragment source code from the virtual file system
+        std::string vertexCode = readSource(vertexPath);
+        std::string fragmentCode = readSource(fragmentPath);
         std::string geometryCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try 
-        {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();		
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
-            // if geometry shader path is present, also load a geometry shader
-            if(geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure& e)
+        // if geometry shader path is present, also load a geometry shader
+        if(geometryPath != nullptr)
+            geometryCode = readSource(geometryPath);
+        if(defines != nullptr)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+            injectDefines(vertexCode, defines);
+            injectDefines(fragmentCode, defines);
+            injectDefines(geometryCode, defines);
         }
         const char* vShaderCode = vertexCode.c_str();
         const char * fShaderCode = fragmentCode.c_str();
@@ -124,6 +97,11 @@ public:
         glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
     }
     // ------------------------------------------------------------------------
+    void setUintArray(const std::string &name, const GLuint* values, int count) const
+    {
+        glUniform1uiv(glGetUniformLocation(ID, name.c_str()), count, values);
+    }
+    // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
         glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
@@ -167,6 +145,56 @@ public:
     }
 
 private:
+    // utility function for reading a shader source through the mounted VFS
+    // #include "file" lines are replaced by that file, relative to the including one
+    // ------------------------------------------------------------------------
+    static std::string readSource(const std::string &path, int depth = 0)
+    {
+        VFS::AssetData data = GetFileSystem().Read(path);
+        if(!data.IsValid())
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+        std::string code = data.String();
+
+        size_t slash = path.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+        size_t line_start = 0;
+        while(line_start < code.size())
+        {
+            size_t line_end = code.find('\n', line_start);
+            if(line_end == std::string::npos)
+                line_end = code.size();
+            size_t first = code.find_first_not_of(" \t", line_start);
+            if(first < line_end && code.compare(first, 8, "#include") == 0)
+            {
+                size_t open = code.find('"', first);
+                size_t close = open < line_end ? code.find('"', open + 1) : std::string::npos;
+                if(close < line_end && depth < 8)
+                {
+                    std::string included = readSource(directory + code.substr(open + 1, close - open - 1), depth + 1);
+                    code.replace(line_start, line_end - line_start, included);
+                    line_end = line_start + included.size();
+                }
+                else
+                    std::cout << "ERROR::SHADER::BAD_INCLUDE in " << path << std::endl;
+            }
+            line_start = line_end + 1;
+        }
+        return code;
+    }
+    // utility function for adding defines to a shader source, #version has to stay the first line
+    // ------------------------------------------------------------------------
+    static void injectDefines(std::string &code, const char* defines)
+    {
+        if(code.empty())
+            return;
+        size_t version = code.find("#version");
+        size_t line_end = version == std::string::npos ? std::string::npos : code.find('\n', version);
+        if(line_end == std::string::npos)
+            code.insert(0, defines);
+        else
+            code.insert(line_end + 1, defines);
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
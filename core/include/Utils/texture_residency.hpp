@@ -0,0 +1,295 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <Utils/resource_manager.hpp>
+
+#include <cstring>
+#include <functional>
+#include <vector>
+
+/// Texture residency
+///
+/// Instead of binding a GL_TEXTURE_2D per draw, every texture gets a material
+/// index. Shaders look the material up in an SSBO and sample through it, so
+/// objects with different textures can share one instanced or multi-draw call.
+///
+/// Two modes:
+/// - RESIDENCY_TEXTURE_ARRAY: same sized textures are packed into
+///   GL_TEXTURE_2D_ARRAY pages, a material is a (page, layer) pair. Draws
+///   batch per page, the page is bound once on MATERIAL_TEXTURE_UNIT.
+/// - RESIDENCY_BINDLESS: needs GL_ARB_bindless_texture and GL_NV_gpu_shader5.
+///   Every texture keeps its own storage and a resident 64-bit handle lives in
+///   the material SSBO, nothing gets bound at all. The material index comes
+///   per instance, so the handle is not dynamically uniform; plain ARB bindless
+///   leaves that undefined, gpu_shader5 allows it.
+///
+/// Shaders pick the mode with `#ifdef BINDLESS_TEXTURES`, see cube.frag.
+///
+/// Storage comes from the ResourceManager. A page whose layers all have a
+/// PixelSource can be evicted under budget pressure and rebuilt on the next
+/// Bind(). Bindless textures stay pinned, their handle is baked into the table.
+
+// GL_ARB_bindless_texture is not part of our glad build, load what we need ourselves
+#ifndef GL_ARB_bindless_texture
+typedef GLuint64 (APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+#endif
+
+enum Residency_Mode {
+    RESIDENCY_TEXTURE_ARRAY,
+    RESIDENCY_BINDLESS
+};
+
+// SSBO binding point of the material table, must match the shaders
+const unsigned int MATERIAL_BINDING      = 0;
+const unsigned int MATERIAL_TEXTURE_UNIT = 0;
+const int          PAGE_LAYERS           = 16;
+
+// Location of a texture inside the array pages
+struct TextureHandle {
+    unsigned int page;
+    unsigned int layer;
+};
+
+// Re-decodes a texture for reloads after eviction, RGBA8
+typedef std::function<bool(std::vector<unsigned char> &rgba, int &width, int &height)> PixelSource;
+
+// Mirrors `struct Material` in the shaders (std430)
+struct GPUMaterial {
+    unsigned int page;
+    unsigned int layer;
+    GLuint64 handle; // bindless only
+};
+static_assert(sizeof(GPUMaterial) == 16, "GPUMaterial must match std430 layout");
+
+class TextureResidency
+{
+public:
+    Residency_Mode Mode = RESIDENCY_TEXTURE_ARRAY;
+
+    // Needs a current context. Uses bindless when the driver supports it,
+    // unless allow_bindless is false.
+    void Init(GLADloadproc load, bool allow_bindless = true)
+    {
+        Mode = RESIDENCY_TEXTURE_ARRAY;
+        if (allow_bindless && hasExtension("GL_ARB_bindless_texture") && hasExtension("GL_NV_gpu_shader5")) {
+            getTextureHandle = (PFNGLGETTEXTUREHANDLEARBPROC)load("glGetTextureHandleARB");
+            makeResident     = (PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)load("glMakeTextureHandleResidentARB");
+            makeNonResident  = (PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)load("glMakeTextureHandleNonResidentARB");
+            if (getTextureHandle && makeResident && makeNonResident)
+                Mode = RESIDENCY_BINDLESS;
+        }
+
+        material_SSBO = GetResourceManager().CreateBuffer(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+    }
+
+    // Defines the shaders need to be compiled with for the current mode
+    const char* ShaderDefines() const
+    {
+        return Mode == RESIDENCY_BINDLESS ? "#define BINDLESS_TEXTURES\n" : "";
+    }
+
+    // Takes tightly packed RGBA8 pixels, returns the material index.
+    // source is optional, without one the texture can never be evicted.
+    unsigned int AddTexture(const unsigned char* rgba, int width, int height, PixelSource source = nullptr)
+    {
+        GPUMaterial material = {};
+        ResourceManager &resources = GetResourceManager();
+
+        if (Mode == RESIDENCY_BINDLESS) {
+            TextureDesc desc;
+            desc.width = width;
+            desc.height = height;
+            desc.levels = mipLevels(width, height);
+            ResourceHandle texture_handle = resources.CreateTexture(desc);
+            GLuint texture = resources.Get(texture_handle);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            setSamplerParams(GL_TEXTURE_2D);
+
+            // Parameters are frozen once a handle exists, so set them first
+            material.handle = getTextureHandle(texture);
+            makeResident(material.handle);
+            bindless_textures.push_back(texture_handle);
+        }
+        else {
+            TextureHandle slot = allocateLayer(width, height);
+            TexturePage &page = pages[slot.page];
+            glBindTexture(GL_TEXTURE_2D_ARRAY, resources.Get(page.texture)); // Get() restores full size if it was evicted
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot.layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+            page.sources.push_back(source);
+            page.dirty = true;
+
+            material.page = slot.page;
+            material.layer = slot.layer;
+        }
+
+        materials.push_back(material);
+        materials_dirty = true;
+        return (unsigned int)materials.size() - 1;
+    }
+
+    // Finishes pending mip generation and uploads the material table.
+    // Call once after loading, before drawing.
+    void Commit()
+    {
+        ResourceManager &resources = GetResourceManager();
+        for (unsigned int i = 0; i < pages.size(); ++i) {
+            TexturePage &page = pages[i];
+            if (!page.dirty)
+                continue;
+            glBindTexture(GL_TEXTURE_2D_ARRAY, resources.Get(page.texture));
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            page.dirty = false;
+
+            bool reloadable = true;
+            for (const PixelSource &source : page.sources)
+                reloadable = reloadable && source;
+            if (reloadable)
+                resources.SetTextureLoader(page.texture, [this, i](GLuint texture, const TextureDesc &desc) { return reloadPage(i, desc); });
+        }
+
+        if (materials_dirty) {
+            resources.BufferData(material_SSBO, GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(GPUMaterial), materials.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            materials_dirty = false;
+        }
+    }
+
+    // Binds the material table. In array mode also binds the page the material
+    // lives in, every material drawn in the same call must share that page.
+    void Bind(unsigned int material)
+    {
+        ResourceManager &resources = GetResourceManager();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, resources.Get(material_SSBO));
+
+        if (Mode == RESIDENCY_TEXTURE_ARRAY && material < materials.size()) {
+            glActiveTexture(GL_TEXTURE0 + MATERIAL_TEXTURE_UNIT);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, resources.Get(pages[materials[material].page].texture));
+        }
+    }
+
+    // True when both materials can be drawn in the same call
+    bool Compatible(unsigned int a, unsigned int b) const
+    {
+        return Mode == RESIDENCY_BINDLESS || materials[a].page == materials[b].page;
+    }
+
+    TextureHandle GetHandle(unsigned int material) const
+    {
+        return { materials[material].page, materials[material].layer };
+    }
+
+    void Release()
+    {
+        for (size_t i = 0; i < materials.size(); ++i) {
+            if (materials[i].handle)
+                makeNonResident(materials[i].handle);
+        }
+        ResourceManager &resources = GetResourceManager();
+        for (ResourceHandle texture : bindless_textures) {
+            resources.Release(texture);
+        }
+        for (TexturePage &page : pages) {
+            resources.Release(page.texture);
+        }
+        resources.Release(material_SSBO);
+
+        bindless_textures.clear();
+        pages.clear();
+        materials.clear();
+        material_SSBO = ResourceHandle();
+    }
+
+private:
+    struct TexturePage {
+        ResourceHandle texture;
+        int width;
+        int height;
+        int used;
+        bool dirty;
+        std::vector<PixelSource> sources; // one per used layer
+    };
+
+    std::vector<TexturePage> pages;
+    std::vector<GPUMaterial> materials;
+    std::vector<ResourceHandle> bindless_textures;
+    ResourceHandle material_SSBO;
+    bool materials_dirty = false;
+
+    PFNGLGETTEXTUREHANDLEARBPROC getTextureHandle = nullptr;
+    PFNGLMAKETEXTUREHANDLERESIDENTARBPROC makeResident = nullptr;
+    PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC makeNonResident = nullptr;
+
+    // Finds a free layer in a page of the same size, or opens a new page
+    TextureHandle allocateLayer(int width, int height)
+    {
+        for (unsigned int i = 0; i < pages.size(); ++i) {
+            if (pages[i].width == width && pages[i].height == height && pages[i].used < PAGE_LAYERS) {
+                return { i, (unsigned int)pages[i].used++ };
+            }
+        }
+
+        TextureDesc desc;
+        desc.target = GL_TEXTURE_2D_ARRAY;
+        desc.width = width;
+        desc.height = height;
+        desc.depth = PAGE_LAYERS;
+        desc.levels = mipLevels(width, height);
+
+        // Pinned until Commit() knows every layer can be reloaded
+        TexturePage page = { GetResourceManager().CreateTexture(desc), width, height, 1, false, {} };
+        setSamplerParams(GL_TEXTURE_2D_ARRAY);
+        pages.push_back(page);
+
+        return { (unsigned int)pages.size() - 1, 0 };
+    }
+
+    // Loader for evicted pages, storage is already allocated and bound
+    bool reloadPage(unsigned int index, const TextureDesc &desc)
+    {
+        const TexturePage &page = pages[index];
+        std::vector<unsigned char> rgba;
+        for (size_t layer = 0; layer < page.sources.size(); ++layer) {
+            int width = 0, height = 0;
+            if (!page.sources[layer](rgba, width, height) || width != desc.width || height != desc.height)
+                return false;
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        }
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        setSamplerParams(GL_TEXTURE_2D_ARRAY);
+        return true;
+    }
+
+    static int mipLevels(int width, int height)
+    {
+        int levels = 1;
+        int size = width > height ? width : height;
+        while (size > 1) {
+            size >>= 1;
+            ++levels;
+        }
+        return levels;
+    }
+
+    static void setSamplerParams(GLenum target)
+    {
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    static bool hasExtension(const char* name)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; ++i) {
+            const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+            if (extension && strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+};
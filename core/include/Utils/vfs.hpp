@@ -0,0 +1,447 @@
+#pragma once
+
+#include <Utils/lz4.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Virtual file system
+///
+/// Assets are looked up by virtual path ("shaders/basic/cube.vert"), relative
+/// to whatever got mounted. Two kinds of mounts:
+/// - Pack: a single assets.pak built by GreyHeavens_pack (tools/pack_assets.cpp),
+///   mapped into memory. Lookups hash the path and probe a table stored in
+///   the pack, so they are O(1). Uncompressed entries are handed out as views
+///   into the mapping, nothing gets copied.
+/// - Directory: loose files, for development. Every read is a real file read.
+///
+/// Later mounts win over earlier ones.
+namespace VFS {
+
+///
+/// Pack layout, everything little endian:
+///
+///   PackHeader
+///   PackEntry[entry_count]
+///   uint32_t buckets[bucket_count]   entry index + 1, 0 is empty
+///   names                            NUL terminated paths
+///   data                             every entry aligned to PACK_ALIGNMENT
+///
+const char     PACK_MAGIC[4]   = { 'G', 'H', 'P', 'K' };
+const uint32_t PACK_VERSION    = 1;
+const uint32_t PACK_ALIGNMENT  = 16;
+
+enum Pack_Compression : uint32_t {
+    PACK_UNCOMPRESSED = 0,
+    PACK_LZ4          = 1
+};
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t bucket_count; // power of two
+    uint64_t entries_offset;
+    uint64_t buckets_offset;
+    uint64_t names_offset;
+};
+
+struct PackEntry {
+    uint64_t hash;
+    uint64_t offset;
+    uint32_t stored_size;
+    uint32_t size;
+    uint32_t compression;
+    uint32_t name_offset;
+};
+
+static_assert(sizeof(PackHeader) == 40, "PackHeader layout is part of the file format");
+static_assert(sizeof(PackEntry) == 32, "PackEntry layout is part of the file format");
+
+// Forward slashes, no leading "./" or "/"
+inline std::string NormalizePath(const std::string &path)
+{
+    std::string normalized = path;
+    for (char &c : normalized) {
+        if (c == '\\')
+            c = '/';
+    }
+    while (normalized.rfind("./", 0) == 0)
+        normalized.erase(0, 2);
+    while (!normalized.empty() && normalized[0] == '/')
+        normalized.erase(0, 1);
+    return normalized;
+}
+
+// FNV-1a 64 of the normalized path
+inline uint64_t HashPath(const std::string &normalized)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : normalized) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Bytes of one asset. Either a view into a mapped pack or an owned buffer,
+// Span() is valid for as long as this object and its mount live.
+class AssetData
+{
+public:
+    AssetData() {}
+
+    static AssetData View(const uint8_t* data, size_t size)
+    {
+        AssetData asset;
+        asset.view = std::span<const uint8_t>(data, size);
+        asset.valid = true;
+        return asset;
+    }
+
+    static AssetData Owned(std::vector<uint8_t> &&data)
+    {
+        AssetData asset;
+        asset.owned = std::move(data);
+        asset.view = std::span<const uint8_t>(asset.owned.data(), asset.owned.size());
+        asset.valid = true;
+        return asset;
+    }
+
+    AssetData(AssetData &&other) noexcept { *this = std::move(other); }
+    AssetData& operator=(AssetData &&other) noexcept
+    {
+        // Moving a vector keeps its buffer, so the view stays correct
+        owned = std::move(other.owned);
+        view = other.view;
+        valid = other.valid;
+        other.view = {};
+        other.valid = false;
+        return *this;
+    }
+    AssetData(const AssetData &) = delete;
+    AssetData& operator=(const AssetData &) = delete;
+
+    std::span<const uint8_t> Span() const { return view; }
+    const uint8_t* Data() const { return view.data(); }
+    size_t Size() const { return view.size(); }
+    bool IsValid() const { return valid; }
+    bool IsView() const { return valid && owned.empty() && !view.empty(); }
+
+    std::string String() const { return std::string((const char*)view.data(), view.size()); }
+
+private:
+    std::span<const uint8_t> view;
+    std::vector<uint8_t> owned;
+    bool valid = false;
+};
+
+class Mount
+{
+public:
+    virtual ~Mount() {}
+    virtual bool Exists(const std::string &normalized) const = 0;
+    virtual AssetData Read(const std::string &normalized) const = 0;
+};
+
+///
+/// Loose files
+///
+class DirectoryMount : public Mount
+{
+public:
+    // root is used as a prefix, it should end with a slash
+    DirectoryMount(const std::string &root) : root(root) {}
+
+    bool Exists(const std::string &normalized) const override
+    {
+        FILE* file = fopen((root + normalized).c_str(), "rb");
+        if (file)
+            fclose(file);
+        return file != nullptr;
+    }
+
+    AssetData Read(const std::string &normalized) const override
+    {
+        FILE* file = fopen((root + normalized).c_str(), "rb");
+        if (!file)
+            return AssetData();
+
+        std::vector<uint8_t> data;
+        if (fseek(file, 0, SEEK_END) == 0) {
+            long size = ftell(file);
+            if (size > 0) {
+                data.resize((size_t)size);
+                fseek(file, 0, SEEK_SET);
+                data.resize(fread(data.data(), 1, data.size(), file));
+            }
+        }
+        fclose(file);
+        return AssetData::Owned(std::move(data));
+    }
+
+private:
+    std::string root;
+};
+
+///
+/// Memory mapped pack
+///
+class PackMount : public Mount
+{
+public:
+    ~PackMount() override
+    {
+        unmap();
+    }
+
+    // False if the file is missing or not a valid pack
+    bool Open(const std::string &path)
+    {
+        if (!map(path))
+            return false;
+
+        if (mapped_size < sizeof(PackHeader)) {
+            unmap();
+            return false;
+        }
+        memcpy(&header, mapped, sizeof(PackHeader));
+
+        bool valid = memcmp(header.magic, PACK_MAGIC, 4) == 0
+            && header.version == PACK_VERSION
+            && header.bucket_count != 0
+            && (header.bucket_count & (header.bucket_count - 1)) == 0
+            && inside(header.entries_offset, (uint64_t)header.entry_count * sizeof(PackEntry))
+            && inside(header.buckets_offset, (uint64_t)header.bucket_count * sizeof(uint32_t))
+            && inside(header.names_offset, 0);
+        if (valid) {
+            entries = (const PackEntry*)(mapped + header.entries_offset);
+            buckets = (const uint32_t*)(mapped + header.buckets_offset);
+        }
+
+        // Every entry once here, so Read() and find() can trust them
+        for (uint32_t i = 0; valid && i < header.entry_count; ++i) {
+            const PackEntry &entry = entries[i];
+            uint64_t name = header.names_offset + (uint64_t)entry.name_offset;
+            valid = inside(entry.offset, entry.stored_size)
+                && (entry.compression == PACK_LZ4 || (entry.compression == PACK_UNCOMPRESSED && entry.size == entry.stored_size))
+                && name < mapped_size
+                && memchr(mapped + name, '\0', mapped_size - name) != nullptr;
+        }
+        if (!valid) {
+            std::cout << "ERROR::VFS::INVALID_PACK: " << path << std::endl;
+            unmap();
+            return false;
+        }
+        return true;
+    }
+
+    bool Exists(const std::string &normalized) const override
+    {
+        return find(normalized) != nullptr;
+    }
+
+    AssetData Read(const std::string &normalized) const override
+    {
+        const PackEntry* entry = find(normalized);
+        if (!entry)
+            return AssetData();
+
+        const uint8_t* stored = mapped + entry->offset;
+        if (entry->compression == PACK_UNCOMPRESSED)
+            return AssetData::View(stored, entry->size);
+
+        std::vector<uint8_t> data(entry->size);
+        if (entry->compression != PACK_LZ4 || !LZ4::Decompress(stored, entry->stored_size, data.data(), data.size())) {
+            std::cout << "ERROR::VFS::CORRUPT_ENTRY: " << normalized << std::endl;
+            return AssetData();
+        }
+        return AssetData::Owned(std::move(data));
+    }
+
+    uint32_t EntryCount() const { return header.entry_count; }
+
+    const PackEntry* Entries() const { return entries; }
+
+    const char* EntryName(const PackEntry &entry) const
+    {
+        return (const char*)(mapped + header.names_offset + entry.name_offset);
+    }
+
+private:
+    PackHeader header = {};
+    const uint8_t* mapped = nullptr;
+    size_t mapped_size = 0;
+    const PackEntry* entries = nullptr;
+    const uint32_t* buckets = nullptr;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+
+    // [offset, offset + size) is within the mapping, without overflowing
+    bool inside(uint64_t offset, uint64_t size) const
+    {
+        return offset <= mapped_size && size <= mapped_size - offset;
+    }
+
+    // Linear probing, the name check guards against hash collisions
+    const PackEntry* find(const std::string &normalized) const
+    {
+        if (!mapped)
+            return nullptr;
+
+        uint64_t hash = HashPath(normalized);
+        uint32_t mask = header.bucket_count - 1;
+        for (uint32_t probe = 0; probe < header.bucket_count; ++probe) {
+            uint32_t bucket = buckets[(hash + probe) & mask];
+            if (bucket == 0 || bucket > header.entry_count)
+                return nullptr;
+
+            const PackEntry* entry = &entries[bucket - 1];
+            if (entry->hash == hash && normalized == EntryName(*entry))
+                return entry;
+        }
+        return nullptr;
+    }
+
+    bool map(const std::string &path)
+    {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            unmap();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+            mapped = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!mapped) {
+            unmap();
+            return false;
+        }
+        mapped_size = (size_t)size.QuadPart;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // The mapping keeps the file alive
+        if (address == MAP_FAILED)
+            return false;
+
+        mapped = (const uint8_t*)address;
+        mapped_size = (size_t)info.st_size;
+#endif
+        return true;
+    }
+
+    void unmap()
+    {
+#ifdef _WIN32
+        if (mapped)
+            UnmapViewOfFile(mapped);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (mapped)
+            munmap((void*)mapped, mapped_size);
+#endif
+        mapped = nullptr;
+        mapped_size = 0;
+        entries = nullptr;
+        buckets = nullptr;
+    }
+};
+
+class FileSystem
+{
+public:
+    bool MountPack(const std::string &path)
+    {
+        std::unique_ptr<PackMount> pack(new PackMount());
+        if (!pack->Open(path))
+            return false;
+        mounts.push_back(std::move(pack));
+        return true;
+    }
+
+    void MountDirectory(const std::string &root)
+    {
+        mounts.push_back(std::unique_ptr<Mount>(new DirectoryMount(root)));
+    }
+
+    void UnmountAll()
+    {
+        mounts.clear();
+    }
+
+    bool Exists(const std::string &path) const
+    {
+        std::string normalized = NormalizePath(path);
+        for (auto it = mounts.rbegin(); it != mounts.rend(); ++it) {
+            if ((*it)->Exists(normalized))
+                return true;
+        }
+        return false;
+    }
+
+    // Invalid AssetData if no mount has it
+    AssetData Read(const std::string &path) const
+    {
+        std::string normalized = NormalizePath(path);
+        for (auto it = mounts.rbegin(); it != mounts.rend(); ++it) {
+            AssetData data = (*it)->Read(normalized);
+            if (data.IsValid())
+                return data;
+        }
+        return AssetData();
+    }
+
+private:
+    std::vector<std::unique_ptr<Mount>> mounts;
+};
+
+}
+
+inline VFS::FileSystem& GetFileSystem()
+{
+    static VFS::FileSystem file_system;
+    return file_system;
+}
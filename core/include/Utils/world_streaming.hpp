@@ -0,0 +1,550 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <Utils/job_system.hpp>
+#include <Utils/mesh_lod.hpp>
+#include <Utils/resource_manager.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/// Streamed, chunked ground
+///
+/// The world is a grid of square chunks keyed by integer (x, z). Every frame
+/// Update() works out which chunks around the camera should be resident:
+/// - everything within load_radius chunks, ranked by distance, with chunks
+///   behind the camera counting as further away
+/// - walking that ranking, chunks are taken until memory_cap is reached
+/// Missing chunks are loaded on the job system, at most max_in_flight at a
+/// time, best ranked first. Chunks nobody wants anymore are dropped, a load
+/// can't be cancelled though: until its result comes back it still takes a
+/// slot and its estimate still counts against memory_cap. Chunks
+/// between load_radius and load_radius + 1 are kept but never loaded, so
+/// walking back and forth over a border doesn't thrash.
+///
+/// Upload() moves finished loads to the GPU, best ranked first, until
+/// upload_budget bytes went up this frame. The main thread never reads files
+/// or generates anything, it only ever swaps a finished list under a mutex.
+///
+/// Loaders also build the chunk's LOD chain (Utils/mesh_lod.hpp) on the worker,
+/// one level per entry of lod_errors, with the borders locked so neighbours at
+/// different levels share every edge vertex. SelectLods() picks the levels.
+
+struct ChunkCoord {
+    int x = 0;
+    int z = 0;
+
+    bool operator==(const ChunkCoord &other) const { return x == other.x && z == other.z; }
+};
+
+struct ChunkCoordHash {
+    size_t operator()(const ChunkCoord &coord) const
+    {
+        return std::hash<uint64_t>()(((uint64_t)(uint32_t)coord.x << 32) | (uint32_t)coord.z);
+    }
+};
+
+// What a loader produces, on a worker thread
+struct ChunkData {
+    std::vector<float> heights;     // (resolution + 1)^2, row major, world space y
+    std::vector<float> vertices;    // x, y, z, u, v in chunk space
+    std::vector<uint32_t> indices;  // every LOD level back to back
+    std::vector<LodLevel> lods;     // full detail first
+    float min_height = 0.0f;
+    float max_height = 0.0f;
+    std::vector<glm::vec3> placements; // world space, one box each for now
+    unsigned int variant = 0;       // picks the material
+};
+
+struct StreamingSettings {
+    float chunk_size = 16.0f;
+    int resolution = 32;            // quads per side
+    int load_radius = 8;            // in chunks
+    size_t memory_cap = 16 * 1024 * 1024;  // heights, placements, vertex and index buffers
+    size_t upload_budget = 256 * 1024;     // per frame
+    unsigned int max_in_flight = 4;
+    std::vector<float> lod_errors = { 0.01f, 0.03f, 0.1f }; // world units, one LOD level each
+    bool gl = true;                 // false: Upload() only drops the CPU copy, for headless runs
+};
+
+typedef std::function<bool(ChunkCoord coord, const StreamingSettings &settings, ChunkData &out)> ChunkLoader;
+
+struct StreamingStats {
+    unsigned int resident_chunks = 0;
+    unsigned int pending_uploads = 0;
+    unsigned int in_flight = 0;     // jobs, including loads nobody wants anymore
+    size_t resident_bytes = 0;      // loading chunks are counted at their estimate
+    size_t upload_bytes = 0;        // this frame
+    unsigned int uploads = 0;       // this frame
+    uint64_t loads_completed = 0;
+    uint64_t unloads = 0;
+    uint64_t dropped_loads = 0;     // finished after nobody wanted them anymore
+    double last_load_ms = 0.0;      // request to resident
+    double average_load_ms = 0.0;
+    double max_load_ms = 0.0;
+    double update_ms = 0.0;         // main thread time, Update() and Upload() of this frame
+};
+
+enum Chunk_State {
+    CHUNK_LOADING,
+    CHUNK_PENDING_UPLOAD,
+    CHUNK_RESIDENT
+};
+
+struct Chunk {
+    ChunkCoord coord;
+    Chunk_State state = CHUNK_LOADING;
+    glm::vec3 origin = glm::vec3(0.0f); // world space corner, the chunk's model matrix is a translation to it
+    ChunkData data;                     // vertices are dropped once uploaded
+    ResourceHandle VAO;
+    ResourceHandle VBO;
+    ResourceHandle EBO;
+    uint32_t lod = 0;                   // level drawn last frame, see SelectLods()
+    size_t bytes = 0;
+    float priority = 0.0f;              // lower loads first
+    uint64_t load_id = 0;               // job that loads it, results of older ones are dropped
+    std::chrono::steady_clock::time_point requested;
+};
+
+// Default loader: a few octaves of value noise, flattened around the origin where the boxes stand
+inline float ChunkNoise(int x, int z, uint32_t seed)
+{
+    uint32_t h = (uint32_t)x * 374761393u + (uint32_t)z * 668265263u + seed * 2246822519u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return (float)((h ^ (h >> 16)) & 0xFFFF) / 65535.0f;
+}
+
+inline float GroundHeight(float x, float z)
+{
+    float height = 0.0f;
+    float amplitude = 2.0f;
+    float frequency = 1.0f / 24.0f;
+    for (uint32_t octave = 0; octave < 3; ++octave) {
+        float fx = x * frequency, fz = z * frequency;
+        int ix = (int)std::floor(fx), iz = (int)std::floor(fz);
+        float tx = fx - ix, tz = fz - iz;
+        tx = tx * tx * (3.0f - 2.0f * tx);
+        tz = tz * tz * (3.0f - 2.0f * tz);
+        float a = glm::mix(ChunkNoise(ix, iz, octave), ChunkNoise(ix + 1, iz, octave), tx);
+        float b = glm::mix(ChunkNoise(ix, iz + 1, octave), ChunkNoise(ix + 1, iz + 1, octave), tx);
+        height += (glm::mix(a, b, tz) * 2.0f - 1.0f) * amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+
+    float distance = std::sqrt(x * x + z * z);
+    float flatten = glm::clamp((distance - 8.0f) / 16.0f, 0.0f, 1.0f);
+    return -1.25f + height * flatten;
+}
+
+inline bool GenerateChunk(ChunkCoord coord, const StreamingSettings &settings, ChunkData &out)
+{
+    int side = settings.resolution + 1;
+    float step = settings.chunk_size / settings.resolution;
+    float origin_x = coord.x * settings.chunk_size;
+    float origin_z = coord.z * settings.chunk_size;
+
+    out.heights.resize((size_t)side * side);
+    out.vertices.resize((size_t)side * side * 5);
+    out.min_height = INFINITY;
+    out.max_height = -INFINITY;
+    for (int row = 0; row < side; ++row) {
+        for (int column = 0; column < side; ++column) {
+            size_t index = (size_t)row * side + column;
+            float x = column * step, z = row * step;
+            float y = GroundHeight(origin_x + x, origin_z + z);
+            out.heights[index] = y;
+            out.min_height = std::min(out.min_height, y);
+            out.max_height = std::max(out.max_height, y);
+
+            float* vertex = &out.vertices[index * 5];
+            vertex[0] = x;
+            vertex[1] = y;
+            vertex[2] = z;
+            vertex[3] = (float)column / settings.resolution;
+            vertex[4] = (float)row / settings.resolution;
+        }
+    }
+
+    out.indices.clear();
+    out.indices.reserve((size_t)settings.resolution * settings.resolution * 6);
+    for (int row = 0; row < settings.resolution; ++row) {
+        for (int column = 0; column < settings.resolution; ++column) {
+            uint32_t corner = row * side + column;
+            out.indices.insert(out.indices.end(), { corner, corner + side, corner + 1, corner + 1, corner + side, corner + side + 1 });
+        }
+    }
+    out.lods = BuildLods(out.vertices.data(), (size_t)side * side, 5, out.indices, settings.lod_errors, LOD_LOCK_BORDER);
+
+    // Up to three boxes sitting on the ground, none near the origin
+    uint32_t placement_seed = ((uint32_t)coord.x * 73856093u) ^ ((uint32_t)coord.z * 19349663u);
+    unsigned int count = (coord.x * coord.x + coord.z * coord.z > 2) ? placement_seed % 4 : 0;
+    out.placements.clear();
+    for (unsigned int i = 0; i < count; ++i) {
+        float x = origin_x + ChunkNoise(coord.x, coord.z, 10 + i) * settings.chunk_size;
+        float z = origin_z + ChunkNoise(coord.x, coord.z, 20 + i) * settings.chunk_size;
+        out.placements.push_back(glm::vec3(x, GroundHeight(x, z) + 0.5f, z));
+    }
+    out.variant = (placement_seed >> 8) % 2;
+    return true;
+}
+
+class WorldStreamer
+{
+public:
+    StreamingSettings Settings;
+    StreamingStats Stats;
+
+    WorldStreamer(StreamingSettings settings = StreamingSettings(), ChunkLoader loader = GenerateChunk)
+        : Settings(settings), loader(loader), inbox(std::make_shared<Inbox>()) {}
+
+    WorldStreamer(const WorldStreamer &) = delete;
+    WorldStreamer& operator=(const WorldStreamer &) = delete;
+
+    // Decides what should be resident around position, collects finished loads and starts new ones
+    void Update(const glm::vec3 &position, const glm::vec3 &front)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Stats.upload_bytes = 0;
+        Stats.uploads = 0;
+
+        rank(position, front);
+
+        // Unload whatever fell out of the ranking, loading chunks are forgotten but their job keeps running
+        for (auto it = chunks.begin(); it != chunks.end();) {
+            if (wanted.count(it->first)) {
+                ++it;
+                continue;
+            }
+            if (it->second.state == CHUNK_RESIDENT)
+                ++Stats.unloads;
+            if (it->second.state == CHUNK_LOADING)
+                ++orphaned_jobs;
+            releaseChunk(it->second);
+            it = chunks.erase(it);
+        }
+
+        collectFinished();
+
+        // New loads, best first
+        for (const Candidate &candidate : ranking) {
+            if (jobs >= Settings.max_in_flight)
+                break;
+            if (!candidate.loadable || chunks.count(candidate.coord))
+                continue;
+            startLoad(candidate);
+        }
+
+        refreshStats();
+        Stats.update_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Finished loads to the GPU, within the per frame byte budget. Call after Update().
+    void Upload()
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<Chunk*> pending;
+        for (auto &entry : chunks) {
+            if (entry.second.state == CHUNK_PENDING_UPLOAD)
+                pending.push_back(&entry.second);
+        }
+        std::sort(pending.begin(), pending.end(), [](const Chunk* a, const Chunk* b) { return a->priority < b->priority; });
+
+        for (Chunk* chunk : pending) {
+            size_t bytes = chunk->data.vertices.size() * sizeof(float) + chunk->data.indices.size() * sizeof(uint32_t);
+            // The first upload of a frame always goes through, a chunk bigger than the budget would never make it otherwise
+            if (Stats.uploads > 0 && Stats.upload_bytes + bytes > Settings.upload_budget)
+                break;
+            uploadChunk(*chunk);
+            Stats.upload_bytes += bytes;
+            ++Stats.uploads;
+        }
+
+        refreshStats();
+        Stats.update_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Resident chunks, in no particular order
+    void ForEachResident(const std::function<void(const Chunk &chunk)> &fn) const
+    {
+        for (const auto &entry : chunks) {
+            if (entry.second.state == CHUNK_RESIDENT)
+                fn(entry.second);
+        }
+    }
+
+    // Picks the level every resident chunk draws this frame, selector.Begin() first
+    void SelectLods(LodSelector &selector)
+    {
+        float half = Settings.chunk_size * 0.5f;
+        for (auto &entry : chunks) {
+            Chunk &chunk = entry.second;
+            if (chunk.state != CHUNK_RESIDENT)
+                continue;
+            float half_height = (chunk.data.max_height - chunk.data.min_height) * 0.5f;
+            glm::vec3 center = chunk.origin + glm::vec3(half, chunk.data.min_height + half_height, half);
+            chunk.lod = selector.Select(chunk.data.lods, chunk.lod, center, glm::length(glm::vec3(half, half_height, half)));
+        }
+    }
+
+    // Ground height from resident data, fallback where nothing is loaded
+    float HeightAt(float x, float z, float fallback = 0.0f) const
+    {
+        ChunkCoord coord = coordAt(x, z);
+        auto it = chunks.find(coord);
+        if (it == chunks.end() || it->second.state != CHUNK_RESIDENT)
+            return fallback;
+
+        const std::vector<float> &heights = it->second.data.heights;
+        int side = Settings.resolution + 1;
+        float step = Settings.chunk_size / Settings.resolution;
+        int column = std::clamp((int)((x - it->second.origin.x) / step + 0.5f), 0, side - 1);
+        int row = std::clamp((int)((z - it->second.origin.z) / step + 0.5f), 0, side - 1);
+        return heights[(size_t)row * side + column];
+    }
+
+    // Call while the context is alive. Loads still in flight finish into an inbox nobody reads.
+    void Release()
+    {
+        for (auto &entry : chunks) {
+            if (entry.second.state == CHUNK_LOADING)
+                ++orphaned_jobs;
+            releaseChunk(entry.second);
+        }
+        chunks.clear();
+    }
+
+private:
+    // Filled by workers, emptied by Update()
+    struct Finished {
+        ChunkCoord coord;
+        uint64_t load_id;
+        bool ok;
+        ChunkData data;
+    };
+
+    struct Inbox {
+        std::mutex mutex;
+        std::vector<Finished> finished;
+    };
+
+    struct Candidate {
+        ChunkCoord coord;
+        float priority;
+        bool loadable; // within load_radius, the rest is only kept if already there
+    };
+
+    ChunkLoader loader;
+    std::shared_ptr<Inbox> inbox;
+    std::unordered_map<ChunkCoord, Chunk, ChunkCoordHash> chunks;
+    std::unordered_set<ChunkCoord, ChunkCoordHash> wanted;
+    std::vector<Candidate> ranking;
+    std::vector<Finished> finished;
+    unsigned int jobs = 0;          // submitted, result not collected yet
+    unsigned int orphaned_jobs = 0; // of those, the ones whose chunk was dropped meanwhile
+    uint64_t last_load_id = 0;
+
+    ChunkCoord coordAt(float x, float z) const
+    {
+        return { (int)std::floor(x / Settings.chunk_size), (int)std::floor(z / Settings.chunk_size) };
+    }
+
+    // What a chunk costs before we have it, never less than what it turns out to be.
+    // BuildLods only keeps a level at most 90% of the one before, one per lod_errors entry.
+    size_t estimatedBytes() const
+    {
+        size_t side = (size_t)Settings.resolution + 1;
+        size_t level_indices = (size_t)Settings.resolution * Settings.resolution * 6;
+        size_t indices = level_indices;
+        for (size_t level = 0; level < Settings.lod_errors.size(); ++level) {
+            level_indices = level_indices * 9 / 10;
+            indices += level_indices;
+        }
+        return side * side * (sizeof(float) + 5 * sizeof(float)) + indices * sizeof(uint32_t)
+             + 3 * sizeof(glm::vec3); // placements, GenerateChunk puts up to three
+    }
+
+    void rank(const glm::vec3 &position, const glm::vec3 &front)
+    {
+        ChunkCoord center = coordAt(position.x, position.z);
+        glm::vec2 forward(front.x, front.z);
+        float forward_length = glm::length(forward);
+        forward = forward_length > 1e-4f ? forward / forward_length : glm::vec2(0.0f);
+
+        int keep_radius = Settings.load_radius + 1;
+        ranking.clear();
+        for (int dz = -keep_radius; dz <= keep_radius; ++dz) {
+            for (int dx = -keep_radius; dx <= keep_radius; ++dx) {
+                int distance_squared = dx * dx + dz * dz;
+                if (distance_squared > keep_radius * keep_radius)
+                    continue;
+
+                ChunkCoord coord = { center.x + dx, center.z + dz };
+                glm::vec2 middle = (glm::vec2((float)coord.x, (float)coord.z) + glm::vec2(0.5f)) * Settings.chunk_size;
+                glm::vec2 offset = middle - glm::vec2(position.x, position.z);
+                float distance = glm::length(offset);
+
+                // Straight ahead counts as is, straight behind as twice as far
+                float facing = distance > 1e-4f ? glm::dot(offset / distance, forward) : 1.0f;
+                float priority = distance * (1.5f - 0.5f * facing);
+
+                bool loadable = distance_squared <= Settings.load_radius * Settings.load_radius;
+                ranking.push_back({ coord, priority, loadable });
+            }
+        }
+        std::sort(ranking.begin(), ranking.end(), [](const Candidate &a, const Candidate &b) { return a.priority < b.priority; });
+
+        // Take the best until the cap is full. Known sizes for what we have, estimates for the rest,
+        // orphaned loads first since their data shows up no matter what.
+        wanted.clear();
+        size_t budget = orphaned_jobs * estimatedBytes();
+        for (Candidate &candidate : ranking) {
+            auto it = chunks.find(candidate.coord);
+            bool present = it != chunks.end();
+            if (!candidate.loadable && !present)
+                continue;
+
+            size_t bytes = present ? it->second.bytes : estimatedBytes();
+            if (budget + bytes > Settings.memory_cap) {
+                candidate.loadable = false;
+                continue;
+            }
+            budget += bytes;
+            wanted.insert(candidate.coord);
+            if (present)
+                it->second.priority = candidate.priority;
+        }
+    }
+
+    void startLoad(const Candidate &candidate)
+    {
+        Chunk &chunk = chunks[candidate.coord];
+        chunk.coord = candidate.coord;
+        chunk.state = CHUNK_LOADING;
+        chunk.origin = glm::vec3(candidate.coord.x * Settings.chunk_size, 0.0f, candidate.coord.z * Settings.chunk_size);
+        chunk.bytes = estimatedBytes();
+        chunk.priority = candidate.priority;
+        chunk.requested = std::chrono::steady_clock::now();
+        chunk.load_id = ++last_load_id;
+
+        std::shared_ptr<Inbox> target = inbox;
+        ChunkLoader load = loader;
+        StreamingSettings settings = Settings;
+        ChunkCoord coord = candidate.coord;
+        uint64_t load_id = chunk.load_id;
+        ++jobs;
+        GetJobSystem().Submit([target, load, settings, coord, load_id] {
+            Finished result;
+            result.coord = coord;
+            result.load_id = load_id;
+            result.ok = load(coord, settings, result.data);
+
+            std::lock_guard<std::mutex> lock(target->mutex);
+            target->finished.push_back(std::move(result));
+        });
+    }
+
+    void collectFinished()
+    {
+        finished.clear();
+        {
+            std::lock_guard<std::mutex> lock(inbox->mutex);
+            finished.swap(inbox->finished);
+        }
+
+        for (Finished &result : finished) {
+            --jobs;
+            auto it = chunks.find(result.coord);
+            if (it == chunks.end() || it->second.state != CHUNK_LOADING || it->second.load_id != result.load_id) {
+                --orphaned_jobs;
+                ++Stats.dropped_loads;
+                continue;
+            }
+
+            Chunk &chunk = it->second;
+            if (!result.ok) {
+                // Try again some other frame
+                chunks.erase(it);
+                continue;
+            }
+            chunk.data = std::move(result.data);
+            // Loaders that don't simplify still get one level, full detail
+            if (chunk.data.lods.empty())
+                chunk.data.lods.push_back({ 0, (uint32_t)chunk.data.indices.size(), 0.0f });
+            chunk.bytes = (chunk.data.heights.size() + chunk.data.vertices.size()) * sizeof(float)
+                        + chunk.data.indices.size() * sizeof(uint32_t)
+                        + chunk.data.placements.size() * sizeof(glm::vec3);
+            chunk.state = CHUNK_PENDING_UPLOAD;
+        }
+    }
+
+    void uploadChunk(Chunk &chunk)
+    {
+        if (Settings.gl) {
+            ResourceManager &resources = GetResourceManager();
+            chunk.VAO = resources.CreateVertexArray();
+            glBindVertexArray(resources.Get(chunk.VAO));
+            chunk.VBO = resources.CreateBuffer(GL_ARRAY_BUFFER, chunk.data.vertices.size() * sizeof(float), chunk.data.vertices.data(), GL_STATIC_DRAW);
+            // Bound with the VAO, so it sticks to it
+            chunk.EBO = resources.CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.data.indices.size() * sizeof(uint32_t), chunk.data.indices.data(), GL_STATIC_DRAW);
+
+            // Same attribute locations as the plane, so plane.vert draws chunks too
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+            glEnableVertexAttribArray(2);
+            glBindVertexArray(0);
+        }
+
+        // The GPU has it now, bytes stay counted through the buffer
+        chunk.data.vertices.clear();
+        chunk.data.vertices.shrink_to_fit();
+        chunk.data.indices.clear();
+        chunk.data.indices.shrink_to_fit();
+        chunk.state = CHUNK_RESIDENT;
+
+        double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - chunk.requested).count();
+        ++Stats.loads_completed;
+        Stats.last_load_ms = latency;
+        Stats.max_load_ms = std::max(Stats.max_load_ms, latency);
+        Stats.average_load_ms += (latency - Stats.average_load_ms) / (double)std::min<uint64_t>(Stats.loads_completed, 64);
+    }
+
+    void releaseChunk(Chunk &chunk)
+    {
+        if (!Settings.gl)
+            return;
+        ResourceManager &resources = GetResourceManager();
+        if (chunk.VAO.IsValid())
+            resources.Release(chunk.VAO);
+        if (chunk.VBO.IsValid())
+            resources.Release(chunk.VBO);
+        if (chunk.EBO.IsValid())
+            resources.Release(chunk.EBO);
+        chunk.VAO = chunk.VBO = chunk.EBO = ResourceHandle();
+    }
+
+    void refreshStats()
+    {
+        Stats.resident_chunks = Stats.pending_uploads = 0;
+        Stats.in_flight = jobs;
+        Stats.resident_bytes = orphaned_jobs * estimatedBytes();
+        for (const auto &entry : chunks) {
+            const Chunk &chunk = entry.second;
+            Stats.resident_chunks += chunk.state == CHUNK_RESIDENT;
+            Stats.pending_uploads += chunk.state == CHUNK_PENDING_UPLOAD;
+            Stats.resident_bytes += chunk.bytes;
+        }
+    }
+};
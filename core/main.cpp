@@ -3,6 +3,11 @@
 #include <SDL3/SDL_main.h>
 
 #include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -14,9 +19,22 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <Utils/vfs.hpp>
+#include <Utils/image.hpp>
+#include <Utils/resource_manager.hpp>
 #include <Utils/primitives.hpp>
 #include <Utils/shader.hpp>
 #include <Utils/camera.hpp>
+#include <Utils/texture_residency.hpp>
+#include <Utils/clustered_lighting.hpp>
+#include <Utils/world_streaming.hpp>
+#include <Utils/mesh_lod.hpp>
+#include <Utils/particles.hpp>
+#include <Utils/debug_draw.hpp>
+#include <Utils/scene_target.hpp>
+#include <Utils/overdraw.hpp>
+#include <Utils/render_stats.hpp>
+#include <Utils/hud.hpp>
 
 static SDL_Window *window = NULL;
 static SDL_Renderer *renderer = NULL;
@@ -29,17 +47,86 @@ Uint64 tick_last = 0;
 
 std::string base_path = SDL_GetBasePath();
 
+TextureResidency texture_residency;
+
+// Mirrors `struct Instance` in cube.vert / plane.vert (std430)
+struct DrawInstance {
+    glm::mat4 model;
+    unsigned int material;
+    unsigned int padding[3];
+};
+const unsigned int INSTANCE_BINDING = 1;
+ResourceHandle instance_SSBO;
+std::vector<DrawInstance> draw_instances;
+
 Shader box_shader;
-unsigned int texture_reimu;
+unsigned int material_reimu;
 
 Shader plane_shader;
-unsigned int texture_morning;
+unsigned int material_morning;
+
+// Ground, streamed in chunks around the camera. Drawn with plane_shader.
+WorldStreamer world;
+// F8, chunk detail by projected error, see Utils/mesh_lod.hpp
+LodSelector lod_selector;
+struct ChunkDraw {
+    GLuint VAO;
+    unsigned int material;
+    unsigned int instance;
+    float depth; // view depth of the chunk's center
+    GLsizei index_count; // of the LOD level picked this frame
+    uint32_t index_offset;
+};
+std::vector<ChunkDraw> chunk_draws;
+// A run of box instances whose materials share a page, one instanced call each
+struct BoxBatch {
+    unsigned int material; // any of the run, for binding its page
+    GLsizei first;
+    GLsizei count;
+};
+std::vector<BoxBatch> box_batches;
 
 Shader skybox_shader;
-unsigned int skybox_texture;
+ResourceHandle skybox_texture;
+
+// Color + float depth the scene draws into, reversed-Z unless toggled with F6
+SceneTarget scene_target;
+
+// Opaque pass: F4 ordering, F5 depth prepass, F7 overdraw view
+Opaque_Order opaque_order = ORDER_FRONT_TO_BACK;
+bool depth_prepass = false;
+bool show_overdraw = false;
+OverdrawCounter overdraw;
+Shader box_depth_shader;
+Shader plane_depth_shader;
+Shader box_overdraw_shader;
+Shader plane_overdraw_shader;
+
+// F1, counters and frame time graph. --stats-out streams the same counters every frame.
+Hud hud;
+bool show_hud = false;
+RenderStatsStream stats_stream;
+uint64_t frame_limit = 0; // --frames, 0 runs until closed
+bool headless = false;    // --headless, hidden window and no vsync, for CI
+
+// Sparks fountain next to the box stacks
+Shader particle_shader;
+ParticleSystem particles(1 << 16);
+
+// F3, chunk bounds and light volumes. Only does anything in Debug builds, see Utils/debug_draw.hpp
+bool show_debug_view = false;
 
 Camera main_camera;
 
+const float NEAR_PLANE = 0.01f;
+const float FAR_PLANE = 1000.0f;
+
+// Scattered around the boxes, bobbing up and down. The last one is a flashlight on the camera.
+ClusteredLighting clustered_lighting;
+std::vector<Light> scene_lights;
+std::vector<glm::vec3> light_anchors;
+unsigned int light_count = 256;
+
 std::vector<glm::vec3> boxes_pos = {
     glm::vec3( 0.0f,  0.0f,  0.0f), 
     glm::vec3( 0.0f,  1.0f,  0.0f), 
@@ -78,24 +165,58 @@ std::vector<glm::vec3> boxes_pos = {
 
 /* Forward Declaration. Cringe, remove later */
 void InitBasicScene();
-unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false);
-unsigned int loadCubemap(std::vector<std::string> faces);
+bool MountAssets();
+unsigned int MaterialFromFile(const char *path);
+ResourceHandle loadCubemap(std::vector<std::string> faces);
+void LogResourceStats();
+void GenerateLights();
+void AnimateLights(float time);
+void DrawDebugView();
+void DrawOpaque(Shader &box_program, Shader &chunk_program, bool shading, GLsizei box_count, const glm::mat4 &view, const glm::mat4 &projection);
 
 /* This function runs once at startup. */
 SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[])
 {
     SDL_Init(SDL_INIT_VIDEO); // Required so RenderDoc can work
 
+    // --texture-budget-mb <n>, 0 or missing means unlimited
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--texture-budget-mb") == 0) {
+            GetResourceManager().SetTextureBudget((size_t)std::strtoull(argv[i + 1], nullptr, 10) * 1024 * 1024);
+        }
+        // --world-cap-mb <n>, resident memory for ground chunks
+        if (strcmp(argv[i], "--world-cap-mb") == 0) {
+            world.Settings.memory_cap = (size_t)std::strtoull(argv[i + 1], nullptr, 10) * 1024 * 1024;
+        }
+        // --lights <n>, point and spot lights in the scene
+        if (strcmp(argv[i], "--lights") == 0) {
+            light_count = (unsigned int)std::strtoul(argv[i + 1], nullptr, 10);
+        }
+        // --stats-out <path>, render stats every frame, CSV for .csv and JSON Lines otherwise
+        if (strcmp(argv[i], "--stats-out") == 0 && !stats_stream.Open(argv[i + 1])) {
+            SDL_Log("Couldn't open %s for render stats", argv[i + 1]);
+        }
+        // --frames <n>, quit after n frames
+        if (strcmp(argv[i], "--frames") == 0) {
+            frame_limit = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--headless") == 0)
+            headless = true;
+    }
+
     SDL_GL_LoadLibrary(NULL);
 	SDL_GL_SetAttribute(SDL_GL_ACCELERATED_VISUAL, 1);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 6);
-	// Request a depth buffer
+	// No depth buffer, the scene target has its own float one
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 0);
 
     /* Create the window */
-    window = SDL_CreateWindow("Grey Heavens", 800, 600, SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL | SDL_WINDOW_MAXIMIZED);
+    SDL_WindowFlags window_flags = headless ? SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN : SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL | SDL_WINDOW_MAXIMIZED;
+    window = SDL_CreateWindow("Grey Heavens", 800, 600, window_flags);
     if (!window) {
         SDL_Log("Couldn't create window and renderer: %s", SDL_GetError());
         return SDL_APP_FAILURE;
@@ -113,18 +234,29 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[])
 		return SDL_APP_FAILURE;
 	}
 
-    // Sync to monitors refresh rate, idk
-    SDL_GL_SetSwapInterval(1);
+    // Counts every GL call from here on
+    GetRenderStats().Install();
+
+    // Sync to monitors refresh rate, idk. Headless runs go as fast as they can.
+    SDL_GL_SetSwapInterval(headless ? 0 : 1);
+
+    if (!MountAssets()) {
+        SDL_Log("Couldn't mount assets from %s", base_path.c_str());
+        return SDL_APP_FAILURE;
+    }
 
     SDL_GetWindowSize(window, &width, &height);
     glViewport(0, 0, width, height);
 
+    scene_target.Init(width, height);
+    overdraw.Init();
+
     glEnable(GL_DEPTH_TEST);
     //glEnable(GL_CULL_FACE); // @TODO: Default VAOs are busted. Use this with proper models instead.
 
     main_camera = Camera(glm::vec3(0.0f, 2.0f, 7.0f)); // Starting pos
 
-    if (!SDL_SetWindowRelativeMouseMode(window, true)) {
+    if (!headless && !SDL_SetWindowRelativeMouseMode(window, true)) {
         SDL_Log("Something fcked up g, can't set WindowRelative: %s", SDL_GetError());
     }
 
@@ -154,6 +286,76 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event)
     if (event->type == SDL_EVENT_WINDOW_RESIZED) {
 		SDL_GetWindowSize(window, &width, &height);
 		glViewport(0, 0, width, height);
+		scene_target.Resize(width, height);
+    }
+
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F2) {
+        LogResourceStats();
+
+        const ClusterStats &lighting = clustered_lighting.Stats;
+        SDL_Log("Lighting: %u lights, %u visible, %u indices, max %u per cluster, %u clusters over the cap, assigned in %.3f ms",
+            lighting.lights, lighting.visible_lights, lighting.light_indices,
+            lighting.max_cluster_lights, lighting.overflowed_clusters, lighting.assign_ms);
+
+        const StreamingStats &streaming = world.Stats;
+        SDL_Log("World: %u chunks resident (%.2f MB), %u loading, %u waiting for upload, load latency %.2f ms avg / %.2f ms max, %llu unloads",
+            streaming.resident_chunks, streaming.resident_bytes / (1024.0 * 1024.0), streaming.in_flight, streaming.pending_uploads,
+            streaming.average_load_ms, streaming.max_load_ms, (unsigned long long)streaming.unloads);
+
+        const LodStats &lod = lod_selector.Stats;
+        SDL_Log("LOD: %u chunks, %llu of %llu triangles (%.1f%%), %u switched level",
+            lod.objects, (unsigned long long)lod.triangles, (unsigned long long)lod.full_triangles,
+            lod.full_triangles ? 100.0 * lod.triangles / lod.full_triangles : 100.0, lod.switches);
+
+        SDL_Log("Particles: %zu alive of %zu, update %.3f ms, pack %.3f ms",
+            particles.Stats.alive, particles.Capacity(), particles.Stats.update_ms, particles.Stats.pack_ms);
+
+        const OverdrawStats &shaded = overdraw.Stats;
+        SDL_Log("Opaque pass: %.2f fragments shaded per pixel (%s, depth prepass %s, %s depth)",
+            shaded.average, opaque_order == ORDER_FRONT_TO_BACK ? "front to back" : "submission order",
+            depth_prepass ? "on" : "off", scene_target.Mode == DEPTH_REVERSED ? "reversed" : "standard");
+
+        const RenderCounters &render = GetRenderStats().Last;
+        SDL_Log("Render: %llu draws, %llu triangles, %llu program / %llu VAO / %llu texture binds, %llu state changes, %llu uniforms",
+            (unsigned long long)render.draw_calls, (unsigned long long)render.triangles, (unsigned long long)render.program_binds,
+            (unsigned long long)render.vao_binds, (unsigned long long)render.texture_binds,
+            (unsigned long long)render.state_changes, (unsigned long long)render.uniform_uploads);
+
+        const DebugDrawStats &debug = GetDebugDraw().Stats;
+        SDL_Log("Debug draw: %zu vertices, %zu dropped, %u draws, waited %.3f ms",
+            debug.vertices, debug.dropped, debug.draws, debug.wait_ms);
+    }
+
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F1) {
+        show_hud = !show_hud;
+    }
+
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F3) {
+        show_debug_view = !show_debug_view;
+    }
+
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F4) {
+        opaque_order = opaque_order == ORDER_FRONT_TO_BACK ? ORDER_SUBMISSION : ORDER_FRONT_TO_BACK;
+        SDL_Log("Opaque order: %s", opaque_order == ORDER_FRONT_TO_BACK ? "front to back" : "submission order");
+    }
+
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F5) {
+        depth_prepass = !depth_prepass;
+        SDL_Log("Depth prepass: %s", depth_prepass ? "on" : "off");
+    }
+
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F6) {
+        scene_target.Mode = scene_target.Mode == DEPTH_REVERSED ? DEPTH_STANDARD : DEPTH_REVERSED;
+        SDL_Log("Depth: %s", scene_target.Mode == DEPTH_REVERSED ? "reversed-Z, infinite far plane" : "standard");
+    }
+
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F7) {
+        show_overdraw = !show_overdraw;
+    }
+
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F8) {
+        lod_selector.Enabled = !lod_selector.Enabled;
+        SDL_Log("Chunk LOD: %s", lod_selector.Enabled ? "on" : "off, full detail everywhere");
     }
 
     if (event->type == SDL_EVENT_MOUSE_MOTION) {
@@ -167,9 +369,13 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event)
 SDL_AppResult SDL_AppIterate(void *appstate)
 {
     SDL_GL_SwapWindow(window);
+    GetRenderStats().BeginFrame();
 
-    glClearColor(0.0f, 0.5f, 1.0f, 0.0f);
-    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    // Frame counter for LRU, evicts cold textures when over budget
+    GetResourceManager().BeginFrame();
+
+    // Black in the overdraw view, so the counts are all that shows
+    scene_target.Begin(show_overdraw ? glm::vec4(0.0f) : glm::vec4(0.0f, 0.5f, 1.0f, 0.0f));
 
     // @TODO:
     // WASD Movement
@@ -197,90 +403,240 @@ SDL_AppResult SDL_AppIterate(void *appstate)
     delta = (double)((tick_current - tick_last) * 0.001f); // @TODO: Ugly casting. Very cringe tbh
     tick_last = tick_current;
 
-    // Draw boxes
-    box_shader.use();
-
     glm::mat4 view = main_camera.GetViewMatrix();
-    glm::mat4 projection = glm::perspective(45.0f, (float) width / (float) height, 0.01f, 1000.0f);
+    glm::mat4 projection = scene_target.Projection(45.0f, (float) width / (float) height, NEAR_PLANE, FAR_PLANE);
 
-    Primitives::UseVAOCube();
+    // Light lists per cluster, before anything that shades
+    AnimateLights(tick_current * 0.001f);
+    clustered_lighting.Update(view, projection, NEAR_PLANE, FAR_PLANE, scene_lights);
+    clustered_lighting.Bind();
+
+    particles.Update((float)delta);
+
+    // Chunks around the camera, loads finish on the job system and never stall the frame
+    world.Update(main_camera.Position, main_camera.Front);
+    world.Upload();
+    lod_selector.Begin(main_camera.Position, projection, (float)height);
+    world.SelectLods(lod_selector);
+
+    // Gather every instance first, one upload per frame.
+    // Boxes (the stacks, then whatever the chunks place) come first, the chunks right after.
+    draw_instances.clear();
     for (int i = 0; i < boxes_pos.size() ; ++i) {
 		glm::mat4 model = glm::mat4(1);
         model = glm::translate(model, boxes_pos[i]);
 
 		//model = glm::rotate(model, glm::radians(45.0f + SDL_GetTicks()) * 0.01f, glm::vec3(0.5f, 1.0f, 0.0f));
 
-		box_shader.setMat4("model", model);
-		box_shader.setMat4("view", view);
-		box_shader.setMat4("projection", projection);
+        draw_instances.push_back({ model, material_reimu });
+    }
+    world.ForEachResident([](const Chunk &chunk) {
+        for (const glm::vec3 &position : chunk.data.placements)
+            draw_instances.push_back({ glm::translate(glm::mat4(1), position), material_reimu });
+    });
+    GLsizei box_count = (GLsizei)draw_instances.size();
+
+    // View space z of a world position is dot(depth_row, position) + view[3][2], bigger is nearer
+    glm::vec3 depth_row(view[0][2], view[1][2], view[2][2]);
+    if (opaque_order == ORDER_FRONT_TO_BACK) {
+        std::sort(draw_instances.begin(), draw_instances.end(), [&depth_row](const DrawInstance &a, const DrawInstance &b) {
+            return glm::dot(depth_row, glm::vec3(a.model[3])) > glm::dot(depth_row, glm::vec3(b.model[3]));
+        });
+    }
+    // Array pages: boxes grouped by page, keeping the order above inside each. Bindless is one batch.
+    if (texture_residency.Mode == RESIDENCY_TEXTURE_ARRAY) {
+        std::stable_sort(draw_instances.begin(), draw_instances.end(), [](const DrawInstance &a, const DrawInstance &b) {
+            return texture_residency.GetHandle(a.material).page < texture_residency.GetHandle(b.material).page;
+        });
+    }
+    box_batches.clear();
+    for (GLsizei i = 0; i < box_count; ++i) {
+        if (box_batches.empty() || !texture_residency.Compatible(box_batches.back().material, draw_instances[i].material))
+            box_batches.push_back({ draw_instances[i].material, i, 0 });
+        ++box_batches.back().count;
+    }
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture_reimu);
-		glDrawArrays(GL_TRIANGLES, 0, 36);
+    ResourceManager &resources = GetResourceManager();
+    chunk_draws.clear();
+    world.ForEachResident([&resources, &depth_row, &view](const Chunk &chunk) {
+        unsigned int material = chunk.data.variant == 0 ? material_morning : material_reimu;
+        glm::vec3 center = chunk.origin + glm::vec3(world.Settings.chunk_size * 0.5f, 0.0f, world.Settings.chunk_size * 0.5f);
+        float depth = -(glm::dot(depth_row, center) + view[3][2]);
+        const LodLevel &level = chunk.data.lods[chunk.lod];
+        chunk_draws.push_back({ resources.Get(chunk.VAO), material, (unsigned int)draw_instances.size(), depth,
+            (GLsizei)level.index_count, level.index_offset });
+        draw_instances.push_back({ glm::translate(glm::mat4(1), chunk.origin), material });
+    });
+    if (opaque_order == ORDER_FRONT_TO_BACK) {
+        // Nearest first, rebinding pages is cheaper than shading what ends up hidden
+        std::sort(chunk_draws.begin(), chunk_draws.end(), [](const ChunkDraw &a, const ChunkDraw &b) { return a.depth < b.depth; });
+    } else {
+        // Grouped by material, so the page only changes once per material
+        std::sort(chunk_draws.begin(), chunk_draws.end(), [](const ChunkDraw &a, const ChunkDraw &b) { return a.material < b.material; });
     }
 
-    // Draw Plane
-    Primitives::UseVAOPlane();
-	glm::mat4 model = glm::mat4(1);
+    resources.BufferData(instance_SSBO, GL_SHADER_STORAGE_BUFFER, draw_instances.size() * sizeof(DrawInstance), draw_instances.data(), GL_STREAM_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BINDING, resources.Get(instance_SSBO));
 
-	// Remember: SRT
-	// Scale first, then rotate, then translate
-	model = glm::scale(model, glm::vec3(5.0f));
-	model = glm::rotate(model, glm::pi<float>(), glm::vec3(1.0f, 0.0f, 0.0f));
+    // Depth only first, then shade exactly the fragments that won
+    if (depth_prepass) {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        DrawOpaque(box_depth_shader, plane_depth_shader, false, box_count, view, projection);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
 
-	// @TODO:
-    // Translation seems to have incorrect axis
-	// Because it's model space? Not world space?
-    // Probably because vertices are busted.
-    // No need to think too much about this for now, just get a proper
-    // primitives model.
-	model = glm::translate(model, glm::vec3(0.0f, 0.25f, 0.0f)); 
+    // Every shaded fragment adds up in the overdraw view
+    if (show_overdraw) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+    }
+    overdraw.Begin((uint64_t)scene_target.Width() * (uint64_t)scene_target.Height());
+    if (show_overdraw)
+        DrawOpaque(box_overdraw_shader, plane_overdraw_shader, false, box_count, view, projection);
+    else
+        DrawOpaque(box_shader, plane_shader, true, box_count, view, projection);
+    overdraw.End();
+
+    glDisable(GL_BLEND);
+    glDepthFunc(scene_target.Less());
+    glDepthMask(GL_TRUE);
+
+    // The overdraw view is opaque only
+    if (!show_overdraw) {
+        // Draw Skybox
+        Primitives::UseVAOSkybox();
+        glDepthFunc(scene_target.LessEqual());
+        skybox_shader.use();
+
+        glm::mat4 skybox_view = glm::mat4(glm::mat3(view)); // To stop translation
+        skybox_shader.setMat4("view", skybox_view);
+        skybox_shader.setMat4("projection", projection);
+        skybox_shader.setFloat("far_depth", scene_target.FarDepth());
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, resources.Get(skybox_texture));
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        glDepthFunc(scene_target.Less());
+
+        // Draw particles, blended so they go last
+        particles.Draw(particle_shader, main_camera, view, projection);
+    }
 
-	plane_shader.use();
-	plane_shader.setMat4("model", model);
-	plane_shader.setMat4("view", view);
-	plane_shader.setMat4("projection", projection);
+    if (show_debug_view)
+        DrawDebugView();
+    GetDebugDraw().Draw(view, projection);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture_morning);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0); // @TODO: need to remember I can do DrawElements for planes
+    scene_target.Resolve();
 
-    // Draw Skybox
-    Primitives::UseVAOSkybox();
-    glDepthFunc(GL_LEQUAL);
-    skybox_shader.use();
+    RenderStats &stats = GetRenderStats();
+    stats.EndFrame();
+    stats_stream.Write(stats);
+    if (show_hud)
+        hud.Draw(stats, width, height);
 
-    view = glm::mat4(glm::mat3(main_camera.GetViewMatrix())); // To stop translation
-    skybox_shader.setMat4("view", view);
-    skybox_shader.setMat4("projection", projection);
+    if (frame_limit > 0 && stats.Frame >= frame_limit)
+        return SDL_APP_SUCCESS;
+    return SDL_APP_CONTINUE;
+}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, skybox_texture);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glDepthFunc(GL_LESS);
+// Boxes, then the ground chunks. Only the shading pass binds materials and lights,
+// the prepass and overdraw programs just need positions and draw every box in one call.
+// Shading draws one instanced call per box batch, a single one in bindless mode.
+// Chunks stay one draw each, every chunk owns its VAO and buffers so there is
+// nothing a multi-draw could share them through.
+void DrawOpaque(Shader &box_program, Shader &chunk_program, bool shading, GLsizei box_count, const glm::mat4 &view, const glm::mat4 &projection)
+{
+    unsigned int bound_material = material_reimu;
+    box_program.use();
+    box_program.setMat4("view", view);
+    box_program.setMat4("projection", projection);
+    if (shading) {
+        clustered_lighting.SetUniforms(box_program, width, height);
+        texture_residency.Bind(bound_material);
+    }
 
-    return SDL_APP_CONTINUE;
+    Primitives::UseVAOCube();
+    if (shading) {
+        for (const BoxBatch &batch : box_batches) {
+            if (!texture_residency.Compatible(bound_material, batch.material))
+                texture_residency.Bind(batch.material);
+            bound_material = batch.material;
+            glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 36, batch.count, batch.first);
+        }
+    } else {
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 36, box_count, 0);
+    }
+
+    // Same shader the plane used
+    chunk_program.use();
+    chunk_program.setMat4("view", view);
+    chunk_program.setMat4("projection", projection);
+    if (shading)
+        clustered_lighting.SetUniforms(chunk_program, width, height);
+
+    for (const ChunkDraw &draw : chunk_draws) {
+        // Only rebinds when the chunk lives in another page
+        if (shading && !texture_residency.Compatible(bound_material, draw.material))
+            texture_residency.Bind(draw.material);
+        bound_material = draw.material;
+
+        glBindVertexArray(draw.VAO);
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, draw.index_count, GL_UNSIGNED_INT,
+            (void*)(draw.index_offset * sizeof(uint32_t)), 1, draw.instance);
+    }
 }
 
 /* This function runs once at shutdown. */
 void SDL_AppQuit(void *appstate, SDL_AppResult result)
 {
+    LogResourceStats();
+
+    // Everything, including Primitives and the shader programs
+    texture_residency.Release();
+    clustered_lighting.Release();
+    world.Release();
+    particles.Release();
+    GetDebugDraw().Release();
+    overdraw.Release();
+    scene_target.Release();
+    hud.Release();
+    GetRenderStats().Release();
+    stats_stream.Close();
+    GetResourceManager().ReleaseAll();
 }
 
 void InitBasicScene() 
 {
+    ///
+    /// Materials
+    /// Bindless when the driver has it, texture array pages otherwise
+    texture_residency.Init((GLADloadproc)SDL_GL_GetProcAddress);
+    SDL_Log("Texture residency: %s", texture_residency.Mode == RESIDENCY_BINDLESS ? "bindless" : "texture arrays");
+
+    instance_SSBO = GetResourceManager().CreateBuffer(GL_SHADER_STORAGE_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+
+    ///
+    /// Lights
+    ///
+    clustered_lighting.Init();
+    GenerateLights();
+
     ///
     /// Box
     ///
-    std::string reimu_image_path = "assets/textures/reimu_timbersaw.png";
-    texture_reimu = TextureFromFile(reimu_image_path.c_str(), base_path);
+    std::string reimu_image_path = "textures/reimu_timbersaw.png";
+    material_reimu = MaterialFromFile(reimu_image_path.c_str());
 
-    std::string box_vert_path = base_path + "assets/shaders/basic/cube.vert";
-    std::string box_frag_path = base_path + "assets/shaders/basic/cube.frag";
-    box_shader = Shader(box_vert_path.c_str(), box_frag_path.c_str());
+    std::string box_vert_path = "shaders/basic/cube.vert";
+    std::string box_frag_path = "shaders/basic/cube.frag";
+    box_shader = Shader(box_vert_path.c_str(), box_frag_path.c_str(), nullptr, texture_residency.ShaderDefines());
+    GetResourceManager().AdoptProgram(box_shader.ID);
 
     box_shader.use();
-    box_shader.setInt("texture1", 0);
+    if (texture_residency.Mode == RESIDENCY_TEXTURE_ARRAY)
+        box_shader.setInt("texture_page", MATERIAL_TEXTURE_UNIT);
 
     ///
     /// Skybox
@@ -295,99 +651,237 @@ void InitBasicScene()
 		"back.jpg"
 	};
     skybox_texture = loadCubemap(faces);  
-    std::string skybox_vert_path = base_path + "assets/shaders/basic/skybox.vert";
-    std::string skybox_frag_path = base_path + "assets/shaders/basic/skybox.frag";
+    std::string skybox_vert_path = "shaders/basic/skybox.vert";
+    std::string skybox_frag_path = "shaders/basic/skybox.frag";
     skybox_shader = Shader(skybox_vert_path.c_str(), skybox_frag_path.c_str());
+    GetResourceManager().AdoptProgram(skybox_shader.ID);
     skybox_shader.use();
     skybox_shader.setInt("skybox", 0);
 
+    ///
+    /// Particles
+    ///
+    std::string particle_vert_path = "shaders/basic/particle.vert";
+    std::string particle_frag_path = "shaders/basic/particle.frag";
+    particle_shader = Shader(particle_vert_path.c_str(), particle_frag_path.c_str());
+    GetResourceManager().AdoptProgram(particle_shader.ID);
+    particles.Init();
+
+    ParticleEmitter fountain;
+    fountain.position = glm::vec3(4.0f, -1.0f, 0.0f);
+    fountain.velocity = glm::vec3(0.0f, 7.0f, 0.0f);
+    fountain.spread = 1.5f;
+    fountain.rate = 10000.0f;
+    fountain.lifetime = 2.5f;
+    particles.Emitters.push_back(fountain);
+
+    GetDebugDraw().Init();
+    hud.Init();
+
     ///
     /// Plane
     ///
-	std::string morning_image_path = "assets/textures/bad_morning.jpg";
-	texture_morning = TextureFromFile(morning_image_path.c_str(), base_path);
+	std::string morning_image_path = "textures/bad_morning.jpg";
+	material_morning = MaterialFromFile(morning_image_path.c_str());
 
-	std::string plane_vert_path = base_path + "assets/shaders/basic/plane.vert";
-	std::string plane_frag_path = base_path + "assets/shaders/basic/plane.frag";
-	plane_shader = Shader(plane_vert_path.c_str(), plane_frag_path.c_str());
+	std::string plane_vert_path = "shaders/basic/plane.vert";
+	std::string plane_frag_path = "shaders/basic/plane.frag";
+	plane_shader = Shader(plane_vert_path.c_str(), plane_frag_path.c_str(), nullptr, texture_residency.ShaderDefines());
+	GetResourceManager().AdoptProgram(plane_shader.ID);
 
 	plane_shader.use();
-	plane_shader.setInt("texture1", 0);
+	if (texture_residency.Mode == RESIDENCY_TEXTURE_ARRAY)
+		plane_shader.setInt("texture_page", MATERIAL_TEXTURE_UNIT);
+
+    ///
+    /// Depth prepass and overdraw view
+    /// Same vertex shaders as the shading pass, so GL_EQUAL matches exactly
+	std::string depth_frag_path = "shaders/basic/depth_only.frag";
+	std::string overdraw_frag_path = "shaders/basic/overdraw.frag";
+	box_depth_shader = Shader(box_vert_path.c_str(), depth_frag_path.c_str());
+	plane_depth_shader = Shader(plane_vert_path.c_str(), depth_frag_path.c_str());
+	box_overdraw_shader = Shader(box_vert_path.c_str(), overdraw_frag_path.c_str());
+	plane_overdraw_shader = Shader(plane_vert_path.c_str(), overdraw_frag_path.c_str());
+	GetResourceManager().AdoptProgram(box_depth_shader.ID);
+	GetResourceManager().AdoptProgram(plane_depth_shader.ID);
+	GetResourceManager().AdoptProgram(box_overdraw_shader.ID);
+	GetResourceManager().AdoptProgram(plane_overdraw_shader.ID);
+
+    // Mips and material table, after every texture is in
+    texture_residency.Commit();
 }
 
-unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma)
+/* Pack next to the executable, or resource/ straight from the source tree with GREYHEAVENS_LOOSE_ASSETS */
+bool MountAssets()
+{
+#ifdef GREYHEAVENS_ASSET_DIR
+    GetFileSystem().MountDirectory(GREYHEAVENS_ASSET_DIR);
+    return true;
+#else
+    return GetFileSystem().MountPack(base_path + "assets.pak");
+#endif
+}
+
+void GenerateLights()
+{
+    scene_lights.clear();
+    light_anchors.clear();
+
+    std::mt19937 random(1337); // Same scene every run
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    for (unsigned int i = 0; i < light_count; ++i) {
+        Light light;
+        light.position = glm::vec3(-6.0f + 14.0f * unit(random), -1.0f + 12.0f * unit(random), -6.0f + 12.0f * unit(random));
+        light.color = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0.1f));
+        light.intensity = 2.0f + 2.0f * unit(random);
+        light.radius = 1.5f + 1.5f * unit(random);
+
+        // Every 8th one is a spot pointing down at the plane
+        if (i % 8 == 7) {
+            light.type = LIGHT_SPOT;
+            light.radius *= 3.0f;
+            light.intensity *= 2.0f;
+        }
+
+        scene_lights.push_back(light);
+        light_anchors.push_back(light.position);
+    }
+
+    Light flashlight;
+    flashlight.type = LIGHT_SPOT;
+    flashlight.intensity = 8.0f;
+    flashlight.radius = 20.0f;
+    flashlight.inner_angle = 0.15f;
+    flashlight.outer_angle = 0.3f;
+    scene_lights.push_back(flashlight);
+}
+
+void AnimateLights(float time)
+{
+    for (size_t i = 0; i < light_anchors.size(); ++i)
+        scene_lights[i].position = light_anchors[i] + glm::vec3(0.0f, 0.5f * std::sin(time + (float)i), 0.0f);
+
+    Light &flashlight = scene_lights.back();
+    flashlight.position = main_camera.Position;
+    flashlight.direction = main_camera.Front;
+}
+
+void DrawDebugView()
+{
+    DebugDraw &debug = GetDebugDraw();
+    debug.Axes(glm::mat4(1.0f), 2.0f);
+
+    // Resident chunks, boxed from their lowest to highest point. Green at full detail, redder the coarser.
+    world.ForEachResident([&debug](const Chunk &chunk) {
+        float size = world.Settings.chunk_size;
+        float coarse = chunk.data.lods.size() > 1 ? (float)chunk.lod / (float)(chunk.data.lods.size() - 1) : 0.0f;
+        debug.Box(glm::vec3(chunk.origin.x, chunk.data.min_height, chunk.origin.z),
+            glm::vec3(chunk.origin.x + size, chunk.data.max_height, chunk.origin.z + size), DebugColor(0.2f + 0.8f * coarse, 1.0f - 0.8f * coarse, 0.2f, 0.5f));
+    });
+
+    // Light radii, spots also get their direction. The flashlight would only box in the camera.
+    for (size_t i = 0; i + 1 < scene_lights.size(); ++i) {
+        const Light &light = scene_lights[i];
+        uint32_t color = DebugColor(light.color.x, light.color.y, light.color.z, 0.6f);
+        debug.Sphere(light.position, light.radius, color);
+        if (light.type == LIGHT_SPOT)
+            debug.Line(light.position, light.position + light.direction * light.radius, color);
+    }
+}
+
+unsigned int MaterialFromFile(const char *path)
 {
     stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on the y-axis.
 
     std::string filename = std::string(path);
-    filename = directory + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
 
+    // Pages are RGBA8 only, let stb expand whatever the file has
     int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    unsigned char *data = LoadImageFile(filename, &width, &height, &nrComponents, 4);
+    if (!data)
     {
-        GLenum format = GL_NONE;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        std::cout << "Material texture failed to load at path: " << path << std::endl;
+        unsigned char fallback[4] = { 255, 0, 255, 255 };
+        return texture_residency.AddTexture(fallback, 1, 1);
     }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
+
+    // Lets the page be evicted, decodes the file again when it comes back
+    PixelSource source = [filename](std::vector<unsigned char> &rgba, int &width, int &height) {
+        stbi_set_flip_vertically_on_load(true);
+        int nrComponents;
+        unsigned char *data = LoadImageFile(filename, &width, &height, &nrComponents, 4);
+        if (!data)
+            return false;
+        rgba.assign(data, data + (size_t)width * height * 4);
         stbi_image_free(data);
-    }
+        return true;
+    };
 
-    return textureID;
+    unsigned int material = texture_residency.AddTexture(data, width, height, source);
+    stbi_image_free(data);
+    return material;
 }
 
-unsigned int loadCubemap(std::vector<std::string> faces)
+ResourceHandle loadCubemap(std::vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    std::vector<std::string> face_paths;
+    for (const std::string &face : faces)
+        face_paths.push_back("textures/cubemap/" + face);
 
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
+    int width = 0, height = 0, nrChannels;
+    if (face_paths.empty() || !ImageInfo(face_paths[0], &width, &height, &nrChannels))
     {
-        std::string face_path = base_path + "assets/textures/cubemap/" + faces[i];
+        std::cout << "Cubemap tex failed to load at path: " << (faces.empty() ? "" : faces[0]) << std::endl;
+        return ResourceHandle();
+    }
 
-        stbi_set_flip_vertically_on_load(false); // tell stb_image.h to flip loaded texture's on the y-axis.
-        unsigned char *data = stbi_load(face_path.c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 
-                         0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-            );
-            stbi_image_free(data);
-        }
-        else
+    TextureDesc desc;
+    desc.target = GL_TEXTURE_CUBE_MAP;
+    desc.internal_format = GL_RGB8;
+    desc.width = width;
+    desc.height = height;
+
+    return GetResourceManager().CreateTexture(desc, [face_paths](GLuint texture, const TextureDesc &desc) {
+        int width, height, nrChannels;
+        for (unsigned int i = 0; i < face_paths.size(); i++)
         {
-            std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+            stbi_set_flip_vertically_on_load(false); // tell stb_image.h to flip loaded texture's on the y-axis.
+            unsigned char *data = LoadImageFile(face_paths[i], &width, &height, &nrChannels, 3);
+            if (data && width == desc.width && height == desc.height)
+            {
+                glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 
+                                0, 0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, data
+                );
+                stbi_image_free(data);
+            }
+            else
+            {
+                std::cout << "Cubemap tex failed to load at path: " << face_paths[i] << std::endl;
+                stbi_image_free(data);
+            }
         }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        return true;
+    });
+}
 
-    return textureID;
-}  
+void LogResourceStats()
+{
+    ResourceStats stats = GetResourceManager().Query();
+    const double mb = 1.0 / (1024.0 * 1024.0);
+
+    SDL_Log("Resources: %u textures (%.2f MB), %u buffers (%.2f MB), %u programs (%.2f MB), %u VAOs, %u FBOs",
+        stats.count[RESOURCE_TEXTURE], stats.bytes[RESOURCE_TEXTURE] * mb,
+        stats.count[RESOURCE_BUFFER], stats.bytes[RESOURCE_BUFFER] * mb,
+        stats.count[RESOURCE_PROGRAM], stats.bytes[RESOURCE_PROGRAM] * mb,
+        stats.count[RESOURCE_VERTEX_ARRAY], stats.count[RESOURCE_FRAMEBUFFER]);
+    SDL_Log("Textures: %u resident (%u degraded, %.2f MB), %u evicted (%.2f MB), budget %.2f MB, %u reloads",
+        stats.resident_textures, stats.degraded_textures, stats.resident_texture_bytes * mb,
+        stats.evicted_textures, stats.evicted_texture_bytes * mb,
+        stats.texture_budget * mb, stats.reloads);
+}
@@ -1,14 +1,41 @@
 #version 460 core
+#ifdef BINDLESS_TEXTURES
+#extension GL_ARB_bindless_texture : require
+// MaterialIndex differs per instance, sampling through a non-uniform handle needs this
+#extension GL_NV_gpu_shader5 : require
+#endif
+
+#include "lighting.glsl"
 
 out vec4 FragColor;
 
 in vec2 TexCoord;
+in vec3 ViewPos;
+flat in uint MaterialIndex;
+
+// See texture_residency.hpp
+struct Material {
+	uint page;
+	uint layer;
+	uvec2 handle;
+};
 
-// texture samplers
-uniform sampler2D texture1;
+layout (std430, binding = 0) readonly buffer Materials {
+	Material materials[];
+};
+
+#ifndef BINDLESS_TEXTURES
+// Page of the current draw, every instance in the draw shares it
+uniform sampler2DArray texture_page;
+#endif
 
 void main()
 {
-	FragColor = texture(texture1, TexCoord);
+	Material material = materials[MaterialIndex];
+#ifdef BINDLESS_TEXTURES
+	vec4 albedo = texture(sampler2D(material.handle), TexCoord);
+#else
+	vec4 albedo = texture(texture_page, vec3(TexCoord, float(material.layer)));
+#endif
+	FragColor = vec4(ClusteredLighting(albedo.rgb, ViewPos, FaceNormal(ViewPos)), albedo.a);
 }
-
@@ -0,0 +1,9 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec4 Color;
+
+void main()
+{
+	FragColor = Color;
+}
@@ -0,0 +1,15 @@
+#version 460 core
+
+// See DebugVertex in debug_draw.hpp
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+
+uniform mat4 view_projection;
+
+out vec4 Color;
+
+void main()
+{
+	gl_Position = view_projection * vec4(aPos, 1.0);
+	Color = aColor;
+}
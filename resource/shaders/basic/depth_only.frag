@@ -0,0 +1,6 @@
+#version 460 core
+
+// Depth prepass, paired with cube.vert / plane.vert. Depth comes from the fixed function.
+void main()
+{
+}
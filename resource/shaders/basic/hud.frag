@@ -0,0 +1,21 @@
+#version 460 core
+out vec4 FragColor;
+
+in vec2 Local;
+flat in uint Glyph;
+in vec4 Color;
+
+// 5x7 glyphs as (low, high) word pairs, see HUD_FONT in hud.hpp
+uniform uint font[128];
+
+void main()
+{
+	if (Glyph != 0xFFFFFFFFu) {
+		uvec2 cell = min(uvec2(Local * vec2(5.0, 7.0)), uvec2(4u, 6u));
+		uint bit = cell.y * 5u + cell.x;
+		uint word = font[Glyph * 2u + bit / 32u];
+		if (((word >> (bit % 32u)) & 1u) == 0u)
+			discard;
+	}
+	FragColor = Color;
+}
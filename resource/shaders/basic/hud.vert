@@ -0,0 +1,23 @@
+#version 460 core
+
+// Per instance, see HudQuad in hud.hpp
+layout (location = 0) in vec4 aRect;
+layout (location = 1) in uint aGlyph;
+layout (location = 2) in vec4 aColor;
+
+uniform vec2 screen_size;
+
+out vec2 Local;
+flat out uint Glyph;
+out vec4 Color;
+
+void main()
+{
+	// Triangle strip over the rectangle, pixels with the origin on the top left
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	vec2 ndc = (aRect.xy + corner * aRect.zw) / screen_size * 2.0 - 1.0;
+	gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+	Local = corner;
+	Glyph = aGlyph;
+	Color = aColor;
+}
@@ -0,0 +1,76 @@
+// Clustered forward lighting, see clustered_lighting.hpp
+// #include "lighting.glsl" after #version, then call ClusteredLighting()
+
+// Keep in sync with clustered_lighting.hpp
+const uint CLUSTER_X = 16u;
+const uint CLUSTER_Y = 9u;
+const uint CLUSTER_Z = 24u;
+
+struct Light {
+	vec4 position_radius;     // view space
+	vec4 direction_cos_outer; // view space
+	vec4 color_cos_inner;
+};
+
+struct Cluster {
+	uint offset;
+	uint count;
+};
+
+layout (std430, binding = 2) readonly buffer Lights {
+	Light lights[];
+};
+
+layout (std430, binding = 3) readonly buffer Clusters {
+	Cluster clusters[];
+};
+
+layout (std430, binding = 4) readonly buffer LightIndices {
+	uint light_indices[];
+};
+
+uniform vec2 cluster_screen_scale; // tiles per pixel
+uniform float cluster_z_scale;     // slice = log(depth) * scale + bias
+uniform float cluster_z_bias;
+uniform vec3 ambient;
+
+uint ClusterIndex(vec3 view_pos)
+{
+	uvec2 tile = min(uvec2(gl_FragCoord.xy * cluster_screen_scale), uvec2(CLUSTER_X - 1u, CLUSTER_Y - 1u));
+	float slice = log(max(-view_pos.z, 1e-4)) * cluster_z_scale + cluster_z_bias;
+	uint z = min(uint(max(slice, 0.0)), CLUSTER_Z - 1u);
+	return tile.x + CLUSTER_X * (tile.y + CLUSTER_Y * z);
+}
+
+// Flat face normal, the primitives don't have normals yet
+vec3 FaceNormal(vec3 view_pos)
+{
+	return normalize(cross(dFdx(view_pos), dFdy(view_pos)));
+}
+
+vec3 ClusteredLighting(vec3 albedo, vec3 view_pos, vec3 normal)
+{
+	vec3 result = ambient * albedo;
+
+	Cluster cluster = clusters[ClusterIndex(view_pos)];
+	for (uint i = 0u; i < cluster.count; ++i) {
+		Light light = lights[light_indices[cluster.offset + i]];
+
+		vec3 to_light = light.position_radius.xyz - view_pos;
+		float distance = length(to_light);
+		float radius = light.position_radius.w;
+		if (distance >= radius)
+			continue;
+		vec3 L = to_light / max(distance, 1e-4);
+
+		// Inverse square, windowed so it reaches zero at the radius
+		float window = clamp(1.0 - pow(distance / radius, 4.0), 0.0, 1.0);
+		float attenuation = window * window / (distance * distance + 1.0);
+
+		// Always 1 for point lights
+		float spot = smoothstep(light.direction_cos_outer.w, light.color_cos_inner.w, dot(-L, light.direction_cos_outer.xyz));
+
+		result += albedo * light.color_cos_inner.rgb * max(dot(normal, L), 0.0) * attenuation * spot;
+	}
+	return result;
+}
@@ -0,0 +1,8 @@
+#version 460 core
+out vec4 FragColor;
+
+// Additively blended once per shaded fragment: dark red at 1, orange around 10, yellow past 20
+void main()
+{
+	FragColor = vec4(0.1, 0.05, 0.025, 1.0);
+}
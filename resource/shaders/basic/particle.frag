@@ -0,0 +1,15 @@
+#version 460 core
+
+out vec4 FragColor;
+
+in vec2 Corner;
+in vec4 Color;
+
+void main()
+{
+	// Round, soft edged
+	float falloff = 1.0 - dot(Corner, Corner);
+	if (falloff <= 0.0)
+		discard;
+	FragColor = vec4(Color.rgb, Color.a * falloff);
+}
@@ -0,0 +1,23 @@
+#version 460 core
+
+// Per instance, see ParticleInstance in particles.hpp
+layout (location = 0) in vec4 aPositionSize;
+layout (location = 1) in vec4 aColor;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 camera_right;
+uniform vec3 camera_up;
+
+out vec2 Corner;
+out vec4 Color;
+
+void main()
+{
+	// Triangle strip: (-1,-1) (1,-1) (-1,1) (1,1)
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	vec3 position = aPositionSize.xyz + (camera_right * corner.x + camera_up * corner.y) * aPositionSize.w;
+	gl_Position = projection * view * vec4(position, 1.0);
+	Corner = corner;
+	Color = aColor;
+}
@@ -3,15 +3,32 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 2) in vec2 aTexCoord;
 
-uniform mat4 model;
+struct Instance {
+	mat4 model;
+	uint material;
+};
+
+// Per-instance data, indexed with gl_BaseInstance so several draws can share one buffer
+layout (std430, binding = 1) readonly buffer Instances {
+	Instance instances[];
+};
+
 uniform mat4 view;
 uniform mat4 projection;
 
+// Same position in the depth prepass as in the GL_EQUAL shading pass
+invariant gl_Position;
+
 out vec2 TexCoord;
+out vec3 ViewPos;
+flat out uint MaterialIndex;
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
+	Instance instance = instances[gl_BaseInstance + gl_InstanceID];
+	vec4 view_pos = view * instance.model * vec4(aPos, 1.0);
+	gl_Position = projection * view_pos;
+	ViewPos = view_pos.xyz;
 	TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+	MaterialIndex = instance.material;
 }
-
@@ -4,6 +4,7 @@ layout (location = 0) in vec3 aPos;
 
 uniform mat4 projection;
 uniform mat4 view;
+uniform float far_depth; // 1 for standard depth, 0 for reversed-Z, see scene_target.hpp
 
 out vec3 TexCoords;
 
@@ -11,5 +12,6 @@ void main()
 {
 	TexCoords = aPos;
 	vec4 pos = projection * view * vec4(aPos, 1.0);
-	gl_Position = pos.xyww;
+	// Pinned to the far plane, drawn last with a less-or-equal test
+	gl_Position = vec4(pos.xy, pos.w * far_depth, pos.w);
 }
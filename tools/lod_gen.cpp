@@ -0,0 +1,176 @@
+/// GreyHeavens_lod
+///
+/// Builds the LOD chain of a model offline, see Utils/mesh_lod.hpp for the
+/// simplifier and the .lod layout.
+///
+///   GreyHeavens_lod <in.obj> <out.lod> [--errors e1,e2,...] [--lock-border]
+///
+/// Reads positions and texture coordinates from a Wavefront OBJ, every
+/// distinct position/uv pair becomes one vertex (x, y, z, u, v), so UV seams
+/// come out as separate vertices and stay put. One level per target error,
+/// in mesh units. Without --errors the targets are 0.25%, 1% and 4% of the
+/// bounding radius. Prints triangles and the measured worst deviation per level.
+
+#include <Utils/mesh_lod.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// OBJ indices are 1 based, negative ones count back from the end
+static int ResolveIndex(const std::string &token, size_t count)
+{
+    if (token.empty())
+        return -1;
+    int index = std::atoi(token.c_str());
+    if (index < 0)
+        index += (int)count;
+    else
+        index -= 1;
+    return (index >= 0 && (size_t)index < count) ? index : -1;
+}
+
+static bool ReadObj(const fs::path &path, LodMesh &mesh)
+{
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "ERROR::LOD::FILE_NOT_SUCCESSFULLY_READ: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> uvs;
+    std::map<std::pair<int, int>, uint32_t> vertex_of;
+    mesh.stride = 5;
+    mesh.vertices.clear();
+    mesh.indices.clear();
+
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        std::istringstream in(line);
+        std::string type;
+        in >> type;
+
+        if (type == "v") {
+            glm::vec3 p(0.0f);
+            in >> p.x >> p.y >> p.z;
+            positions.push_back(p);
+        }
+        else if (type == "vt") {
+            glm::vec2 uv(0.0f);
+            in >> uv.x >> uv.y;
+            uvs.push_back(uv);
+        }
+        else if (type == "f") {
+            std::vector<uint32_t> polygon;
+            std::string corner;
+            while (in >> corner) {
+                size_t slash = corner.find('/');
+                int position = ResolveIndex(corner.substr(0, slash), positions.size());
+                int uv = -1;
+                if (slash != std::string::npos) {
+                    size_t next = corner.find('/', slash + 1);
+                    uv = ResolveIndex(corner.substr(slash + 1, next == std::string::npos ? std::string::npos : next - slash - 1), uvs.size());
+                }
+                if (position < 0) {
+                    std::cout << "ERROR::LOD::BAD_FACE: line " << line_number << std::endl;
+                    return false;
+                }
+
+                auto it = vertex_of.find({ position, uv });
+                if (it == vertex_of.end()) {
+                    glm::vec3 p = positions[position];
+                    glm::vec2 t = uv >= 0 ? uvs[uv] : glm::vec2(0.0f);
+                    mesh.vertices.insert(mesh.vertices.end(), { p.x, p.y, p.z, t.x, t.y });
+                    it = vertex_of.emplace(std::make_pair(position, uv), (uint32_t)vertex_of.size()).first;
+                }
+                polygon.push_back(it->second);
+            }
+
+            // Fans, faces are expected to be convex
+            for (size_t i = 2; i < polygon.size(); ++i)
+                mesh.indices.insert(mesh.indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+        }
+    }
+    return !mesh.indices.empty();
+}
+
+static std::vector<float> ParseErrors(const std::string &list)
+{
+    std::vector<float> errors;
+    std::stringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ','))
+        errors.push_back(std::strtof(item.c_str(), nullptr));
+    std::sort(errors.begin(), errors.end());
+    return errors;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        std::cout << "Usage: GreyHeavens_lod <in.obj> <out.lod> [--errors e1,e2,...] [--lock-border]" << std::endl;
+        return 1;
+    }
+
+    std::vector<float> errors;
+    unsigned int flags = 0;
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--errors" && i + 1 < argc)
+            errors = ParseErrors(argv[++i]);
+        else if (arg == "--lock-border")
+            flags |= LOD_LOCK_BORDER;
+    }
+
+    LodMesh mesh;
+    if (!ReadObj(argv[1], mesh))
+        return 1;
+
+    ComputeLodBounds(mesh);
+    if (errors.empty())
+        errors = { mesh.radius * 0.0025f, mesh.radius * 0.01f, mesh.radius * 0.04f };
+
+    auto start = std::chrono::steady_clock::now();
+    BuildLods(mesh, errors, flags);
+    double build_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<uint8_t> data = SerializeLodMesh(mesh);
+    fs::path out_path(argv[2]);
+    if (out_path.has_parent_path())
+        fs::create_directories(out_path.parent_path());
+    std::ofstream out(out_path, std::ios::binary);
+    out.write((const char*)data.data(), (std::streamsize)data.size());
+    if (!out) {
+        std::cout << "ERROR::LOD::CANNOT_WRITE: " << out_path << std::endl;
+        return 1;
+    }
+
+    uint32_t full = mesh.levels[0].index_count / 3;
+    std::cout << argv[1] << ": " << mesh.VertexCount() << " vertices, radius " << mesh.radius
+              << ", built in " << std::fixed << std::setprecision(1) << build_ms << " ms" << std::endl;
+    std::cout << "  level   triangles        %       error   error/radius" << std::endl;
+    for (size_t i = 0; i < mesh.levels.size(); ++i) {
+        const LodLevel &level = mesh.levels[i];
+        uint32_t triangles = level.index_count / 3;
+        std::cout << std::setw(7) << i << std::setw(12) << triangles
+                  << std::setw(9) << std::setprecision(1) << 100.0 * triangles / full
+                  << std::setw(12) << std::setprecision(5) << level.error
+                  << std::setw(15) << std::setprecision(5) << (mesh.radius > 0.0f ? level.error / mesh.radius : 0.0f) << std::endl;
+    }
+    if (mesh.levels.size() < errors.size() + 1)
+        std::cout << "  " << errors.size() + 1 - mesh.levels.size() << " target(s) skipped, not 10% smaller than the level before" << std::endl;
+    std::cout << "Wrote " << data.size() << " bytes to " << out_path.string() << std::endl;
+    return 0;
+}
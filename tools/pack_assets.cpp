@@ -0,0 +1,239 @@
+/// GreyHeavens_pack
+///
+/// Builds the assets.pak the game mounts through Utils/vfs.hpp, see there for
+/// the layout. Run by the GreyHeavens_assets target on every build.
+///
+///   GreyHeavens_pack <resource dir> <out.pak> [--no-compress]
+///   GreyHeavens_pack --bench [file count] [repetitions]
+///
+/// --bench writes a set of small files to a temp directory, packs them and
+/// compares opening + reading every one of them loose vs through the pack.
+
+#include <Utils/vfs.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Entries have to shrink at least this much to be stored compressed
+const double MIN_COMPRESSION_GAIN = 0.9;
+
+struct PackSource {
+    std::string name; // normalized virtual path
+    fs::path path;
+};
+
+static bool ReadWholeFile(const fs::path &path, std::vector<uint8_t> &data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return false;
+    data.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read((char*)data.data(), (std::streamsize)data.size());
+    return (bool)file;
+}
+
+static std::vector<PackSource> CollectSources(const fs::path &root)
+{
+    std::vector<PackSource> sources;
+    for (const fs::directory_entry &entry : fs::recursive_directory_iterator(root)) {
+        if (!entry.is_regular_file())
+            continue;
+        std::string name = VFS::NormalizePath(fs::relative(entry.path(), root).generic_string());
+        sources.push_back({ name, entry.path() });
+    }
+
+    // Stable output, same input gives the same pack
+    std::sort(sources.begin(), sources.end(), [](const PackSource &a, const PackSource &b) { return a.name < b.name; });
+    return sources;
+}
+
+static bool WritePack(const std::vector<PackSource> &sources, const fs::path &out_path, bool compress, bool verbose)
+{
+    uint32_t bucket_count = 1;
+    while (bucket_count < sources.size() * 2)
+        bucket_count <<= 1;
+
+    std::vector<VFS::PackEntry> entries(sources.size());
+    std::vector<uint32_t> buckets(bucket_count, 0);
+    std::string names;
+
+    for (uint32_t i = 0; i < sources.size(); ++i) {
+        entries[i].hash = VFS::HashPath(sources[i].name);
+        entries[i].name_offset = (uint32_t)names.size();
+        names += sources[i].name;
+        names.push_back('\0');
+
+        uint32_t mask = bucket_count - 1;
+        uint32_t bucket = (uint32_t)(entries[i].hash & mask);
+        while (buckets[bucket] != 0) {
+            if (entries[buckets[bucket] - 1].hash == entries[i].hash) {
+                std::cout << "ERROR::PACK::HASH_COLLISION: " << sources[i].name << std::endl;
+                return false;
+            }
+            bucket = (bucket + 1) & mask;
+        }
+        buckets[bucket] = i + 1;
+    }
+
+    VFS::PackHeader header = {};
+    memcpy(header.magic, VFS::PACK_MAGIC, 4);
+    header.version = VFS::PACK_VERSION;
+    header.entry_count = (uint32_t)entries.size();
+    header.bucket_count = bucket_count;
+    header.entries_offset = sizeof(VFS::PackHeader);
+    header.buckets_offset = header.entries_offset + entries.size() * sizeof(VFS::PackEntry);
+    header.names_offset = header.buckets_offset + buckets.size() * sizeof(uint32_t);
+
+    // Data blob, compressed where it pays off
+    std::vector<uint8_t> blob;
+    uint64_t data_offset = header.names_offset + names.size();
+    data_offset = (data_offset + VFS::PACK_ALIGNMENT - 1) / VFS::PACK_ALIGNMENT * VFS::PACK_ALIGNMENT;
+    size_t total_size = 0;
+
+    std::vector<uint8_t> data, compressed;
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (!ReadWholeFile(sources[i].path, data)) {
+            std::cout << "ERROR::PACK::FILE_NOT_SUCCESSFULLY_READ: " << sources[i].path << std::endl;
+            return false;
+        }
+
+        compressed.clear();
+        if (compress && !data.empty())
+            LZ4::Compress(data.data(), data.size(), compressed);
+
+        bool use_compressed = compress && !data.empty() && compressed.size() < data.size() * MIN_COMPRESSION_GAIN;
+        const std::vector<uint8_t> &stored = use_compressed ? compressed : data;
+
+        while (blob.size() % VFS::PACK_ALIGNMENT != 0)
+            blob.push_back(0);
+        entries[i].offset = data_offset + blob.size();
+        entries[i].size = (uint32_t)data.size();
+        entries[i].stored_size = (uint32_t)stored.size();
+        entries[i].compression = use_compressed ? VFS::PACK_LZ4 : VFS::PACK_UNCOMPRESSED;
+        blob.insert(blob.end(), stored.begin(), stored.end());
+        total_size += data.size();
+
+        if (verbose)
+            std::cout << "  " << sources[i].name << " " << data.size() << (use_compressed ? " -> " + std::to_string(stored.size()) : "") << std::endl;
+    }
+
+    std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cout << "ERROR::PACK::CANNOT_WRITE: " << out_path << std::endl;
+        return false;
+    }
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(VFS::PackEntry)));
+    out.write((const char*)buckets.data(), (std::streamsize)(buckets.size() * sizeof(uint32_t)));
+    out.write(names.data(), (std::streamsize)names.size());
+    for (uint64_t i = header.names_offset + names.size(); i < data_offset; ++i)
+        out.put('\0');
+    out.write((const char*)blob.data(), (std::streamsize)blob.size());
+
+    if (verbose)
+        std::cout << "Packed " << sources.size() << " files, " << total_size << " -> " << blob.size() << " bytes" << std::endl;
+    return (bool)out;
+}
+
+///
+/// Benchmark
+///
+static double Median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+static int Bench(int file_count, int repetitions)
+{
+    fs::path root = fs::temp_directory_path() / "greyheavens_vfs_bench";
+    fs::path loose = root / "loose";
+    fs::path pack_path = root / "bench.pak";
+    fs::remove_all(root);
+    fs::create_directories(loose);
+
+    // Small, mildly compressible files, spread over a few directories like real assets
+    std::mt19937 rng(1234);
+    std::vector<std::string> names;
+    for (int i = 0; i < file_count; ++i) {
+        std::string name = "dir" + std::to_string(i % 16) + "/file" + std::to_string(i) + ".bin";
+        fs::create_directories((loose / name).parent_path());
+
+        std::vector<char> content(64 + rng() % 4032);
+        for (size_t j = 0; j < content.size(); ++j)
+            content[j] = (char)('a' + (rng() % 8));
+        std::ofstream(loose / name, std::ios::binary).write(content.data(), (std::streamsize)content.size());
+        names.push_back(name);
+    }
+
+    for (int compress = 0; compress < 2; ++compress) {
+        if (!WritePack(CollectSources(loose), pack_path, compress != 0, false))
+            return 1;
+
+        std::vector<double> loose_times, pack_times, mount_times;
+        size_t checksum = 0;
+        for (int r = 0; r < repetitions; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            VFS::DirectoryMount directory(loose.generic_string() + "/");
+            for (const std::string &name : names)
+                checksum += directory.Read(name).Size();
+            auto middle = std::chrono::steady_clock::now();
+
+            VFS::PackMount pack;
+            pack.Open(pack_path.string());
+            auto mounted = std::chrono::steady_clock::now();
+            for (const std::string &name : names)
+                checksum += pack.Read(name).Size();
+            auto end = std::chrono::steady_clock::now();
+
+            loose_times.push_back(std::chrono::duration<double, std::micro>(middle - start).count());
+            mount_times.push_back(std::chrono::duration<double, std::micro>(mounted - middle).count());
+            pack_times.push_back(std::chrono::duration<double, std::micro>(end - mounted).count());
+        }
+
+        double loose_us = Median(loose_times);
+        double pack_us = Median(pack_times);
+        std::cout << (compress ? "lz4 pack:  " : "raw pack:  ")
+                  << file_count << " files, median of " << repetitions << "\n"
+                  << "  loose   " << loose_us << " us (" << loose_us / file_count << " us/file)\n"
+                  << "  mount   " << Median(mount_times) << " us\n"
+                  << "  pack    " << pack_us << " us (" << pack_us / file_count << " us/file)\n"
+                  << "  speedup " << (pack_us > 0.0 ? loose_us / pack_us : 0.0) << "x"
+                  << "  (checksum " << checksum << ")" << std::endl;
+    }
+
+    fs::remove_all(root);
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc >= 2 && std::string(argv[1]) == "--bench") {
+        int file_count = argc >= 3 ? std::atoi(argv[2]) : 4096;
+        int repetitions = argc >= 4 ? std::atoi(argv[3]) : 15;
+        return Bench(std::max(file_count, 1), std::max(repetitions, 1));
+    }
+
+    if (argc < 3) {
+        std::cout << "Usage: GreyHeavens_pack <resource dir> <out.pak> [--no-compress]\n"
+                  << "       GreyHeavens_pack --bench [file count] [repetitions]" << std::endl;
+        return 1;
+    }
+
+    bool compress = !(argc >= 4 && std::string(argv[3]) == "--no-compress");
+    fs::path out_path(argv[2]);
+    if (out_path.has_parent_path())
+        fs::create_directories(out_path.parent_path());
+
+    return WritePack(CollectSources(argv[1]), out_path, compress, true) ? 0 : 1;
+}